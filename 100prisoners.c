@@ -1,328 +1,2773 @@
-/*
- * Author:  Wesley Araujo
- * License: Creative Commons Attribution 4.0
- *          http://creativecommons.org/licenses/by/4.0/
- *
- * Simulation of the 100 prisoner problem using the best strategy to
- * estimate the probability that all prisoners succeed.
- *
- * Explanation of the problem can be found on wikipedia or
- * the youtube video links below:
- * http://en.wikipedia.org/wiki/100_prisoners_problem
- *
- * The youtube videos inspired me to do this simulation.
- * "An Impossible Bet"
- * https://www.youtube.com/watch?v=eivGlBKlK6M
- * "Solution to The Impossible Bet"
- * https://www.youtube.com/watch?v=C5-I0bAuEUE
- *
- * True value is about = 0.31182782
- * Obtained with WolframAlpha:
- * http://www.wolframalpha.com/input/?i=1+-+%28HarmonicNumber[100]+-+HarmonicNumber[50]%29
- */
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <pthread.h>
-#include <math.h>
-#include <unistd.h>
-
-#include <sys/mman.h>
-#include <sys/wait.h>
-
-#include "100prisoners.h"
-
-#ifndef UNION
-#define UNION
-#include "union-find/union-find.h"
-#endif
-
-#ifdef PRNG
-
-#if PRNG == 1
-#include "MRG32k3a/MRG32k3a.h"
-#endif
-
-#if PRNG == 2
-#include "dSFMT/dSFMT.h"
-dsfmt_t dsfmt;
-#endif
-
-#if PRNG == 3
-#include "Lfib4/Lfib4.h"
-#endif
-
-#endif
-
-#define DEFAULT_NUM_PRISONERS 100
-#define MAX_TRIALS 50
-#define MAX_uint32 ((1UL << (sizeof(unsigned int)*8)) - 1)
-#define DEBUG 0
-
-
-/* ignore enums for now
-enum PRNG_enum {
-    c_random,
-    MRG32k3a,
-    dSFMT
-};
-*/
-
-int main(int argc, char* argv[]) {
-    if (argc == 3) {
-        int inputNumSimulations = atoi(argv[1]);
-        if (*argv[2] == 's') { // simulate sequentially
-            int sum = simulateAndStats(inputNumSimulations, "Sequence (Single Thread / Process)");
-            printStats(sum, inputNumSimulations, "Sequence (Single Thread / Process)");
-        }
-        else {
-            printUsage();
-        }
-    }
-    else if (argc == 4) {
-        int inputNumSimulations = atoi(argv[1]);
-        if (*argv[2] == 'p') { // simulate with processes
-            int numProcesses = atoi(argv[3]);
-            simulateAndStatsWithProcesses(inputNumSimulations, numProcesses);
-        }
-        else {
-            printUsage();
-        }
-    }
-    else {
-        printUsage();
-    }
-    return EXIT_SUCCESS;
-}
-
-void printUsage(void) {
-    puts("Usage:\n"
-         "\tsimuBestop numSimulations processOrNot numProcess\n"
-         "\teg. Simulate 1234 with 4 processes\n"
-         "\tsimuBestop 1234 p 4\n"
-         "\teg. Simulate 1234 sequentially (1 process)\n"
-         "\tsimuBestop 1234 s");
-}
-
-int simulateAndStats(int n, char* caller) {
-    int sum = 0;
-
-    seed(); // seed to randomize boxes array in simulation
-    set_union s;
-    for (int i=0; i<n; i++) {
-        sum += runSimulation(&s); // simulation performed here
-    }
-#if DEBUG == 1
-    printStats(sum, n, caller);
-#endif
-    return sum;
-}
-
-enum found_t runSimulation(set_union* s) {
-    return single_simulation(s, DEFAULT_NUM_PRISONERS);
-}
-
-enum found_t runNaiveSimulation(void) {
-    const int num = DEFAULT_NUM_PRISONERS;
-    int prisoners[num];
-    int boxes[num];
-
-    for (int i=0; i<num; i++) {
-        prisoners[i] = i;
-        boxes[i] = i;
-    }
-
-    randomizeArray(boxes, num);
-
-    for (int i=0; i<num; i++) {
-        // if one prisoner does not find his tag, then return NOT_FOUND = 0, since
-        // not all prisoners found their tag.
-        if (lookForTag(prisoners[i], boxes) == NOT_FOUND) {
-            return NOT_FOUND;
-        }
-    }
-    // if all prisoners found their tag, then return FOUND = 1
-    return FOUND;
-}
-
-int lookForTag(int prisonerNum, int boxes[]) {
-    int currentNum = prisonerNum;
-
-    // have the prisoner check each box
-    for (int trials=0; trials<MAX_TRIALS; trials++) {
-        if (prisonerNum == boxes[currentNum]) { // prisoner checks number inside box
-            return FOUND;
-        }
-        else {
-            currentNum = boxes[currentNum]; // use number in box to search for next box
-        }
-    }
-    return NOT_FOUND; // exhausted all 50 boxes
-}
-
-void printStats(int sum, int n, char* caller) {
-    double mean = sum / (n + 0.0);
-    // standard variance formula = ( sigmaSum(x^2) * n*mean^2 ) / (n - 1)
-    // since sigmaSum(x^2) = sum because each simulation is a Bernoulli random variable,
-    // and mean = sum / n, then
-    // variance = (sum * (n*sum^2)/n^2) / (n-1) = (sum * sum^2/n) / (n-1) = (sum*(1 - mean))/(n-1)
-    double var = (sum*(1 - mean))/(n-1);
-    printf("\nStatistics of %s:\n", caller);
-    printf("Number of simulations: %d\n", n);
-    printf("Parameter Estimate = %f\n", mean);
-    printf("Variance is %f\n", var);
-    printf("95%% CI: {%f, %f}\n",
-           mean - 1.96*sqrt(var/n),
-           mean + 1.96*sqrt(var/n));
-}
-
-enum found_t single_simulation(set_union* s, int size) {
-    int currentIndex = size - 1;
-    int randomIndex;
-
-    set_union_init(s, DEFAULT_NUM_PRISONERS);
-    while (currentIndex > 0) {
-        randomIndex = randomInt(currentIndex);
-
-        union_set(s, currentIndex, randomIndex);
-        if (s->size[find(s, currentIndex)] > MAX_TRIALS) {
-            return NOT_FOUND;
-        }
-
-        currentIndex--;
-    }
-    return FOUND;
-}
-
-void randomizeArray(int* array, int size) {
-    int currentIndex = size - 1;
-    int randomIndex;
-    int toSwap;
-
-    while (currentIndex > 0) {
-        randomIndex = randomInt(currentIndex);
-
-        toSwap = array[randomIndex];
-        array[randomIndex] = array[currentIndex];
-        array[currentIndex] = toSwap;
-
-        currentIndex--;
-    }
-}
-
-unsigned int randomInt(int currentIndex) {
-#if PRNG == 0 // default c PRNG
-    return random() % (currentIndex+1);
-#elif PRNG == 1 // MRG32k3a PRNG
-    return MRG32k3a() * (currentIndex+1);
-#elif PRNG == 2 // dSFMT (successor of mersenne twister)
-    return dsfmt_genrand_close_open(&dsfmt) * (currentIndex+1);
-#elif PRNG == 3 // Marsa Lfib4 PRNG
-    // to removing inherit bias of modulus, uncomment below,
-    // although there isn't much point since one needs to
-    // be performing simulations to obtain 8 digits of
-    // precision or more... (100/((2^32) - 1) ~= 10^-8)
-
-    /*unsigned int randVal = Lfib4();
-    unsigned int modOfMax = MAX_uint32 % (currentIndex+1);
-    while (randVal >= MAX_uint32 - modOfMax) randVal = Lfib4();
-
-    return randVal % (currentIndex+1);*/
-    return Lfib4() % (currentIndex+1); // comment this out if above is uncommented
-#endif
-}
-
-void seed(void) {
-    FILE* urandom = fopen("/dev/urandom", "r");
-    if (urandom == NULL) {
-        perror("Couldn't open urandom file");
-        exit(EXIT_FAILURE);
-    }
-
-    unsigned int seedVal;
-    if (fread(&seedVal, sizeof(seedVal), 1, urandom) == 0) {
-        perror("Couldn't read urandom file");
-        exit(EXIT_FAILURE);
-    }
-#if PRNG == 0
-    srandom(seedVal);
-#elif PRNG == 1
-    unsigned int seeds[6];
-    seeds[0] = seedVal; // store first rand value at 0
-
-    // store remaining 5 rand values in seeds[1] to seeds[5]
-    if (fread(seeds + 1, sizeof(unsigned int), 5, urandom) == 0) {
-        perror("Couldn't read urandom file for MRG");
-        exit(EXIT_FAILURE);
-    }
-    mrg_seed_array(seeds);
-#elif PRNG == 2
-    dsfmt_init_gen_rand(&dsfmt, seedVal);
-#elif PRNG == 3
-    unsigned int seeds[1 << 8];
-    if (fread(seeds, sizeof(unsigned int), 1 << 8, urandom) == 0) {
-        perror("Couldn't read urandom file for Lfib4");
-        exit(EXIT_FAILURE);
-    }
-    Lfib4_seed((unsigned char)seedVal, seeds);
-#endif
-
-    fclose(urandom);
-}
-
-void simulateAndStatsWithProcesses(int n, int numProcesses) {
-    int pid, sum = 0;
-    // create array that all processes can communicate with
-    int* successes = mmap(NULL, sizeof(int)*numProcesses,
-                          PROT_WRITE|PROT_READ, MAP_ANON|MAP_SHARED, -1, 0);
-    struct simParam listOfParam[numProcesses];
-
-    // let parent fork() multiple times and wait for children to simulate.
-    for (int i=0; i<numProcesses; i++) {
-        pid = fork();
-        if (pid == 0) { // children
-            listOfParam[i].taskName =       "Process";
-            listOfParam[i].successes =      successes;
-            listOfParam[i].taskNum =        i;
-            listOfParam[i].numSimulations = n / numProcesses;
-            splitSimulation(&listOfParam[i]);
-            exit(EXIT_SUCCESS); // children finished simulating
-        }
-        else if (pid < 0) { // failed
-            perror("fork failed");
-            exit(EXIT_FAILURE);
-        }
-    }
-    while (wait(NULL) > 0); // let parent wait for all children processes to exit
-
-    for (int i=0; i<numProcesses; i++) {
-        sum += successes[i];
-    }
-    int numSimulation = (n / numProcesses)*numProcesses; // integer division
-    printStats(sum, numSimulation, "All processes");
-}
-
-void* splitSimulation(struct simParam* p) {
-    // specify whether this function is being called by thread or process,
-    // specify their taskNum, and number of simulations they will perform
-    printf("%s %d, number of simulations to perform: %d\n",
-           p->taskName, p->taskNum + 1, p->numSimulations);
-
-    char nameAndNum[20]; // string variable to contain taskNume and taskNum
-    int idealBufSize = snprintf(nameAndNum, sizeof(nameAndNum),
-                                "%s %d", p->taskName, p->taskNum + 1);
-    int sum;
-    // if array of 20 char is not enough
-    if (idealBufSize > sizeof(nameAndNum)) {
-        char secondaryBuf[idealBufSize];
-        snprintf(secondaryBuf, sizeof(secondaryBuf),
-                 "%s %d", p->taskName, p->taskNum + 1);
-        sum = simulateAndStats(p->numSimulations, secondaryBuf);
-    }
-    else {
-        sum = simulateAndStats(p->numSimulations, nameAndNum);
-    }
-    p->successes[p->taskNum] = sum; // store number of successes in respective location
-
-    return NULL;
-}
+/*
+ * Author:  Wesley Araujo
+ * License: Creative Commons Attribution 4.0
+ *          http://creativecommons.org/licenses/by/4.0/
+ *
+ * Simulation of the 100 prisoner problem using the best strategy to
+ * estimate the probability that all prisoners succeed.
+ *
+ * Explanation of the problem can be found on wikipedia or
+ * the youtube video links below:
+ * http://en.wikipedia.org/wiki/100_prisoners_problem
+ *
+ * The youtube videos inspired me to do this simulation.
+ * "An Impossible Bet"
+ * https://www.youtube.com/watch?v=eivGlBKlK6M
+ * "Solution to The Impossible Bet"
+ * https://www.youtube.com/watch?v=C5-I0bAuEUE
+ *
+ * True value is about = 0.31182782
+ * Obtained with WolframAlpha:
+ * http://www.wolframalpha.com/input/?i=1+-+%28HarmonicNumber[100]+-+HarmonicNumber[50]%29
+ */
+
+#define _GNU_SOURCE
+#ifndef __linux__
+#error "100prisoners needs Linux with glibc, see README.md"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <math.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <signal.h>
+
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "100prisoners.h"
+
+#ifndef EXECUTOR
+#define EXECUTOR
+#include "executor/executor.h"
+#endif
+
+#ifndef UNION
+#define UNION
+#include "union-find/union-find.h"
+#endif
+
+#ifndef ARENA
+#define ARENA
+#include "arena/arena.h"
+#endif
+
+#ifndef STORE
+#define STORE
+#include "store/store.h"
+#endif
+
+#ifndef TRACE
+#define TRACE
+#include "trace/trace.h"
+#endif
+
+#ifndef JOINT
+#define JOINT
+#include "joint/joint.h"
+#endif
+
+#ifndef TABLES
+#define TABLES
+#include "tables/tables.h"
+#endif
+
+#ifndef PUBLISH
+#define PUBLISH
+#include "publish/publish.h"
+#endif
+
+#ifndef HISTOGRAM
+#define HISTOGRAM
+#include "histogram/histogram.h"
+#endif
+
+#ifndef PRNG
+#define PRNG 0
+#endif
+
+// every PRNG is compiled in, PRNG only selects the default one
+#include "MRG32k3a/MRG32k3a.h"
+#include "dSFMT/dSFMT.h"
+#include "Lfib4/Lfib4.h"
+
+__thread dsfmt_t dsfmt;
+
+// random_r instead of random(), so each thread has its own state instead of
+// sharing one behind a lock
+static __thread struct random_data randomData;
+static __thread int32_t randomState[32]; // initstate_r needs its state int32_t aligned
+
+#define DEFAULT_NUM_PRISONERS 100
+#define MAX_TRIALS 50
+#define MAX_uint32 ((1UL << (sizeof(unsigned int)*8)) - 1)
+#define DEBUG 0
+
+// trials are grouped in blocks that each start from a freshly keyed stream,
+// so the result of a chunk does not depend on which worker simulated it.
+#define TRIAL_BLOCK 256
+#define CHUNK_SIZE (40*TRIAL_BLOCK)
+#define CHUNKS_PER_WORKER 4
+#define DEFAULT_HALF_WIDTH 1e-3
+#define EXACT_MAX_PRISONERS 100000000
+#define STRAGGLER_FACTOR 2.0
+#define STRAGGLER_POLL_NS 1000000
+#define DEFAULT_STORE_PATH "results.log"
+#define JOINT_MAX_PRISONERS 8192
+#define DEFAULT_TABLES_PATH "tables.bin"
+#define EXACT_MIN_PROBABILITY 1e-15
+#define NODE_BATCH_PER_THREAD 2
+#define PUBLISH_INTERVAL_NS 100000000
+#define SUBSCRIBE_INTERVAL_NS 500000000
+#define SUBSCRIBE_STALE_SECONDS 10
+#define REPLAY_MAX_BOXES_PRINTED 200
+#define PREFETCH_CURSORS 16
+#define PREFETCH_WALKED ((int)(1U << 31)) // flags of a box in the prefetch simulation
+#define PREFETCH_START (1 << 30)
+#define PREFETCH_MAX_PRISONERS PREFETCH_START
+#define REPLAY_MAX_NAIVE_STEPS 1000000000L
+#define DRAW_EXACT_MIN 4096 // ranges from which 32 bit draws are reduced without bias
+#define CYCLES_STREAM 0x6379636C65730000ULL // keys the draws only histograms need
+
+// number of prisoners and boxes each prisoner may open, set by -n and -k
+static int numPrisoners = DEFAULT_NUM_PRISONERS;
+static int trialsPerPrisoner = MAX_TRIALS;
+
+// PRNG of runs, set by -g, and PRNG of the chunk the calling thread simulates
+static enum prng_t defaultPrng = PRNG;
+static __thread enum prng_t prng = PRNG;
+static const char* prngNames[] = {"random", "mrg32k3a", "dsfmt", "lfib4"};
+
+// antithetic pairs of trials, set by -A, and numbers drawn for the current pair
+static int antithetic = 0;
+static __thread enum draw_mode drawMode = DRAW_FRESH;
+static __thread int* draws;
+static __thread int lowestDrawn; // last index drawn in DRAW_RECORD mode
+
+// cycle histograms, set by -H
+static int histograms = 0;
+
+// spawn the worker processes instead of forking them, set by --spawn
+static int spawnWorkers = 0;
+extern char** environ;
+
+// kernel used to simulate, set by -m
+static enum method_t method = METHOD_UNION;
+static const char* methodNames[] = {"union", "naive", "packed", "packed-union", "prefetch"};
+
+// buffers of this process or thread, reused by every chunk it simulates
+static __thread struct workspace workerSpace;
+
+// results store, set by -o, --no-store and -r
+static const char* storePath = DEFAULT_STORE_PATH;
+static int resumeResults = 0;
+static store results;
+static int resultsOpen = 0;
+static pthread_mutex_t resultsLock = PTHREAD_MUTEX_INITIALIZER;
+
+// worker timeline, written to the file given with --trace
+static const char* tracePath = NULL;
+static tracer tracing;
+static __thread int traceWorker = -1; // buffer of the calling worker
+static int traceWorkerOffset = 0;     // buffer of this process's first executor thread
+
+// joint success counts, written to the file given with -J
+static const char* jointPath = NULL;
+
+// live snapshot of the run, published under the name given with --publish
+static const char* publishName = NULL;
+static publisher live;
+static struct publish_snapshot published; // runs of this process already done
+static double publishStart;
+
+// seed of the run, set by --seed instead of read from urandom
+static uint64_t fixedSeed;
+static int seedGiven = 0;
+
+// exact cycle tables, set by --tables
+static const char* tablesPath = DEFAULT_TABLES_PATH;
+
+// the PRNG of a run is part of its key, the build only tells the compiler
+#define BUILD_ID __VERSION__ ", " __DATE__ " " __TIME__
+
+int main(int argc, char* argv[]) {
+    int kMin = 0, kMax = 0;
+    double halfWidth = DEFAULT_HALF_WIDTH;
+    int tablesMaxN = 0, exact = 0;
+    long replayIndex = -1;
+    const char* subscribeName = NULL;
+
+    static struct option longOptions[] = {
+        {"prisoners",  required_argument, NULL, 'n'},
+        {"method",     required_argument, NULL, 'm'},
+        {"prng",       required_argument, NULL, 'g'},
+        {"boxes",      required_argument, NULL, 'k'},
+        {"sweep",      required_argument, NULL, 'K'},
+        {"half-width", required_argument, NULL, 'w'},
+        {"store",      required_argument, NULL, 'o'},
+        {"no-store",   no_argument,       NULL, 'O'},
+        {"resume",     no_argument,       NULL, 'r'},
+        {"trace",      required_argument, NULL, 'T'},
+        {"joint-matrix", required_argument, NULL, 'J'},
+        {"tables",     required_argument, NULL, 'X'},
+        {"build-tables", required_argument, NULL, 'B'},
+        {"exact",      no_argument,       NULL, 'E'},
+        {"antithetic", no_argument,       NULL, 'A'},
+        {"seed",       required_argument, NULL, 'S'},
+        {"replay-trial", required_argument, NULL, 'R'},
+        {"publish",    required_argument, NULL, 'P'},
+        {"histograms", no_argument,       NULL, 'H'},
+        {"subscribe",  required_argument, NULL, 'U'},
+        {"spawn",      no_argument,       NULL, 'F'},
+        {"worker",     required_argument, NULL, 'W'}, // internal, see runWorker
+        {NULL, 0, NULL, 0}
+    };
+    int opt, workerFd = -1, workerIndex = 0;
+    trialsPerPrisoner = 0;
+    while ((opt = getopt_long(argc, argv, "n:k:m:g:K:w:o:rJ:AH", longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'n':
+            numPrisoners = atoi(optarg);
+            break;
+        case 'k':
+            trialsPerPrisoner = atoi(optarg);
+            break;
+        case 'm':
+            method = METHOD_COUNT;
+            for (int i=0; i<METHOD_COUNT; i++) {
+                if (strcmp(optarg, methodNames[i]) == 0) method = i;
+            }
+            if (method == METHOD_COUNT) {
+                printUsage();
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'g':
+            defaultPrng = PRNG_COUNT;
+            for (int i=0; i<PRNG_COUNT; i++) {
+                if (strcmp(optarg, prngNames[i]) == 0) defaultPrng = i;
+            }
+            if (defaultPrng == PRNG_COUNT) {
+                printUsage();
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'K':
+            if (sscanf(optarg, "%d:%d", &kMin, &kMax) != 2) {
+                printUsage();
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'w':
+            halfWidth = atof(optarg);
+            break;
+        case 'o':
+            storePath = optarg;
+            break;
+        case 'O':
+            storePath = NULL;
+            break;
+        case 'r':
+            resumeResults = 1;
+            break;
+        case 'T':
+            tracePath = optarg;
+            break;
+        case 'J':
+            jointPath = optarg;
+            break;
+        case 'X':
+            tablesPath = optarg;
+            break;
+        case 'B':
+            tablesMaxN = atoi(optarg);
+            break;
+        case 'E':
+            exact = 1;
+            break;
+        case 'A':
+            antithetic = 1;
+            break;
+        case 'S':
+            fixedSeed = strtoull(optarg, NULL, 0);
+            seedGiven = 1;
+            break;
+        case 'P':
+            publishName = optarg;
+            break;
+        case 'H':
+            histograms = 1;
+            break;
+        case 'U':
+            subscribeName = optarg;
+            break;
+        case 'F':
+            spawnWorkers = 1;
+            break;
+        case 'W':
+            if (sscanf(optarg, "%d:%d", &workerFd, &workerIndex) != 2) {
+                printUsage();
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'R':
+            replayIndex = atol(optarg);
+            if (replayIndex < 0) {
+                printUsage();
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    argc -= optind - 1; // keep the positional arguments at argv[1], argv[2], ...
+    argv += optind - 1;
+
+    if (workerFd >= 0) { // spawned by simulateChunksWithProcesses
+        runWorker(workerFd, workerIndex);
+    }
+
+    prng = defaultPrng;
+    if (exact && kMin == 0 && trialsPerPrisoner == 0) { // whole distribution
+        kMin = 1;
+        kMax = numPrisoners;
+    }
+    if (trialsPerPrisoner == 0) trialsPerPrisoner = numPrisoners / 2;
+    if (kMin == 0) kMin = kMax = trialsPerPrisoner;
+    if (numPrisoners < 1 || trialsPerPrisoner < 1 || trialsPerPrisoner > numPrisoners ||
+        kMin < 1 || kMax < kMin || kMax > numPrisoners) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    if (publishName != NULL && (argc < 3 || strchr("pc", *argv[2]) == NULL)) {
+        printUsage(); // a sweep has no single estimate to publish
+        return EXIT_FAILURE;
+    }
+
+    // the streams of a seed are always the same, as are the trials of a
+    // resumed sweep, which start at trial 0 of every point
+    if (resumeResults && seedGiven && argc > 2 && storedSeed(fixedSeed, kMin, kMax)) {
+        fprintf(stderr, "Results of seed %llu are already stored, -r would count them twice\n",
+                (unsigned long long)fixedSeed);
+        return EXIT_FAILURE;
+    }
+
+    if (publishName != NULL) {
+        if (publish_open(&live, publishName) != 0) {
+            perror("Couldn't create the published snapshot");
+        }
+        published.numPrisoners = numPrisoners;
+        published.maxTrials = trialsPerPrisoner;
+        published.numBins = PUBLISH_BINS;
+        publishStart = now();
+    }
+
+    int status = EXIT_SUCCESS;
+    if (subscribeName != NULL) { // watch a run publishing its snapshot
+        subscribeResults(subscribeName);
+    }
+    else if (replayIndex >= 0) { // regenerate one trial of a run
+        if (!seedGiven) {
+            fprintf(stderr, "--replay-trial needs the run's --seed\n");
+            return EXIT_FAILURE;
+        }
+        // the mode of the run, if given after the options
+        char mode = argc > 1 ? *argv[1] : 's';
+        if (strchr("spthkc", mode) == NULL) {
+            fprintf(stderr, "--replay-trial only replays s, p, t, h, k and c mode runs\n");
+            return EXIT_FAILURE;
+        }
+        replayTrial(fixedSeed, replayIndex, mode);
+    }
+    else if (tablesMaxN > 0) { // precompute the exact cycle tables
+        buildTables(tablesMaxN);
+    }
+    else if (exact) { // query the exact cycle tables
+        printExact(kMin, kMax);
+    }
+    else if (argc == 2 && *argv[1] == 'q') { // query the results store
+        queryResults(kMin, kMax);
+    }
+    else if (antithetic && (argc < 3 || strchr("spth", *argv[2]) == NULL)) {
+        printUsage(); // the CI of the other modes assumes independent trials
+        status = EXIT_FAILURE;
+    }
+    else if (histograms && (argc < 3 || strchr("spk", *argv[2]) == NULL)) {
+        printUsage();
+        status = EXIT_FAILURE;
+    }
+    else if (spawnWorkers && (argc < 3 || strchr("pck", *argv[2]) == NULL)) {
+        printUsage(); // only these modes start worker processes
+        status = EXIT_FAILURE;
+    }
+    else if (argc == 3) {
+        int inputNumSimulations = atoi(argv[1]);
+        if (antithetic) inputNumSimulations += inputNumSimulations % 2; // whole pairs
+        if (*argv[2] == 's') { // simulate sequentially
+            simulateSequentially(inputNumSimulations);
+        }
+        else {
+            printUsage();
+            status = EXIT_FAILURE;
+        }
+    }
+    else if (argc == 4) {
+        int inputNumSimulations = atoi(argv[1]);
+        if (antithetic) inputNumSimulations += inputNumSimulations % 2;
+        if (*argv[2] == 'p') { // simulate with processes
+            int numProcesses = atoi(argv[3]);
+            simulateAndStatsWithProcesses(inputNumSimulations, numProcesses);
+        }
+        else if (*argv[2] == 't') { // simulate with threads
+            int numThreads = atoi(argv[3]);
+            simulateAndStatsWithThreads(inputNumSimulations, numThreads);
+        }
+        else if (*argv[2] == 'd') { // run jobs read from stdin
+            int numThreads = atoi(argv[3]);
+            runDaemon(inputNumSimulations, numThreads);
+        }
+        else if (*argv[2] == 'c') { // compare every PRNG within one run
+            int numProcesses = atoi(argv[3]);
+            consensusWithProcesses(inputNumSimulations, numProcesses);
+        }
+        else if (*argv[2] == 'h') { // simulate with processes of threads
+            int threadsPerNode = atoi(argv[3]);
+            simulateAndStatsHybrid(inputNumSimulations, threadsPerNode);
+        }
+        else if (*argv[2] == 'j') { // joint success of every pair of prisoners
+            int numThreads = atoi(argv[3]);
+            jointWithThreads(inputNumSimulations, numThreads);
+        }
+        else if (*argv[2] == 'k') { // adaptive sweep over the number of boxes
+            int numProcesses = atoi(argv[3]);
+            sweepWithProcesses(kMin, kMax, halfWidth, inputNumSimulations, numProcesses);
+        }
+        else {
+            printUsage();
+            status = EXIT_FAILURE;
+        }
+    }
+    else {
+        printUsage();
+        status = EXIT_FAILURE;
+    }
+
+    if (tracing.buffers != NULL && trace_dump(&tracing, tracePath) != 0) {
+        perror("Couldn't write trace");
+    }
+    if (live.segment != NULL) {
+        published.done = 1;
+        publish_write(&live, &published);
+        publish_close(&live);
+    }
+    return status;
+}
+
+void printUsage(void) {
+    puts("Usage:\n"
+         "\tsimuBestop [options] numSimulations processOrNot numProcess\n"
+         "\teg. Simulate 1234 with 4 processes\n"
+         "\tsimuBestop 1234 p 4\n"
+         "\teg. Simulate 1234 sequentially (1 process)\n"
+         "\tsimuBestop 1234 s\n"
+         "\teg. Sweep 30 to 70 boxes opened per prisoner with 4 processes, spending\n"
+         "\tat most 10000000 simulations until every 95% CI half width is <= 0.001\n"
+         "\tsimuBestop -K 30:70 -w 0.001 10000000 k 4\n"
+         "\teg. Simulate 1234 with 4 processes, split between every PRNG, and\n"
+         "\tcompare the PRNGs' estimates with each other and the exact value\n"
+         "\tsimuBestop 1234 c 4\n"
+         "\teg. Simulate 1234 with 4 threads\n"
+         "\tsimuBestop 1234 t 4\n"
+         "\teg. Simulate 1234 with a process per NUMA node, each running 4 threads\n"
+         "\t(0 for one per CPU of the node)\n"
+         "\tsimuBestop 1234 h 4\n"
+         "\teg. Count the simulations in which both prisoners of every pair find\n"
+         "\ttheir tag with 4 threads, and write the counts to joint.txt\n"
+         "\tsimuBestop -J joint.txt 1234 j 4\n"
+         "\teg. Run the jobs read from stdin with 4 threads, one job per line\n"
+         "\t\"[numSimulations [n [k]]]\", missing fields default to 1234, -n and -k\n"
+         "\tsimuBestop 1234 d 4\n"
+         "\teg. Print the stored results of 100 prisoners opening 30 to 70 boxes\n"
+         "\tsimuBestop -n 100 -K 30:70 q\n"
+         "\teg. Print the cycles of trial 123456789 of the run with seed 42, and\n"
+         "\tthe verdict of every kernel on it\n"
+         "\tsimuBestop --seed 42 --replay-trial 123456789\n"
+         "\teg. Build the exact cycle tables for up to 2000 boxes, then print the\n"
+         "\texact success probability of 100 prisoners opening 30 to 70 boxes\n"
+         "\tsimuBestop --build-tables 2000\n"
+         "\tsimuBestop -n 100 -K 30:70 --exact\n"
+         "Options:\n"
+         "\t-n, --prisoners n          number of prisoners and boxes (default 100)\n"
+         "\t-k, --boxes k              boxes opened per prisoner (default n / 2)\n"
+         "\t-m, --method name          union (default), naive, packed, packed-union\n"
+         "\t                           or prefetch\n"
+         "\t-g, --prng name            random, mrg32k3a, dsfmt or lfib4 (default set by PRNG)\n"
+         "\t-K, --sweep kMin:kMax      range of boxes opened per prisoner (k mode)\n"
+         "\t-w, --half-width width     target 95% CI half width (k mode)\n"
+         "\t-o, --store path           results store (default " DEFAULT_STORE_PATH ")\n"
+         "\t    --no-store             do not store the results\n"
+         "\t-r, --resume               add the stored results of the same configuration\n"
+         "\t    --trace path           write a Chrome trace of every worker's timeline\n"
+         "\t-J, --joint-matrix path    write the joint success counts (j mode)\n"
+         "\t    --tables path          exact cycle tables (default " DEFAULT_TABLES_PATH ")\n"
+         "\t    --build-tables maxN    compute the exact cycle tables for up to maxN boxes\n"
+         "\t    --exact                print the exact distributions of -n boxes' cycles\n"
+         "\t-A, --antithetic           simulate in antithetic pairs (s, p, t and h modes)\n"
+         "\t    --seed seed            seed of the run instead of a random one\n"
+         "\t    --replay-trial index   print a trial of the run with --seed, followed by\n"
+         "\t                           the run's mode if c (d and j runs cannot be replayed)\n"
+         "\t    --publish name         publish live estimates in shared memory (p and c modes)\n"
+         "\t    --subscribe name       print the live estimates of the run publishing name\n"
+         "\t-H, --histograms           collect the distributions of the cycles (s, p and k modes)\n"
+         "\t    --spawn                spawn the worker processes instead of forking them (p, c and k modes)");
+}
+
+int simulateAndStats(int n, char* caller) {
+    int sum = 0;
+
+    seed(); // seed to randomize boxes array in simulation
+    initWorkspace(&workerSpace, numPrisoners);
+    for (int i=0; i<n; i++) {
+        sum += runKernel(&workerSpace, trialsPerPrisoner); // simulation performed here
+    }
+#if DEBUG == 1
+    printStats(sum, n, caller);
+#endif
+    return sum;
+}
+
+enum found_t runSimulation(set_union* s) {
+    return single_simulation(s, numPrisoners, trialsPerPrisoner);
+}
+
+enum found_t runKernel(struct workspace* w, int maxTrials) {
+    switch (method) {
+    case METHOD_NAIVE:
+        return runNaiveSimulation(w->boxes, w->size, maxTrials);
+    case METHOD_PACKED:
+        return runPackedSimulation(w, maxTrials);
+    case METHOD_PACKED_UNION:
+        return single_simulation_packed(&w->forest, w->size, maxTrials);
+    case METHOD_PREFETCH:
+        return runPrefetchSimulation(w, maxTrials);
+    default:
+        return single_simulation(&w->s, w->size, maxTrials);
+    }
+}
+
+enum found_t runNaiveSimulation(int boxes[], int size, int maxTrials) {
+    const int num = size;
+
+    for (int i=0; i<num; i++) {
+        boxes[i] = i;
+    }
+
+    randomizeArray(boxes, num);
+
+    for (int i=0; i<num; i++) {
+        // if one prisoner does not find his tag, then return NOT_FOUND = 0, since
+        // not all prisoners found their tag.
+        // prisoner i is looking for tag number i
+        if (lookForTag(i, boxes, maxTrials) == NOT_FOUND) {
+            return NOT_FOUND;
+        }
+    }
+    // if all prisoners found their tag, then return FOUND = 1
+    return FOUND;
+}
+
+int lookForTag(int prisonerNum, int boxes[], int maxTrials) {
+    int currentNum = prisonerNum;
+
+    // have the prisoner check each box
+    for (int trials=0; trials<maxTrials; trials++) {
+        if (prisonerNum == boxes[currentNum]) { // prisoner checks number inside box
+            return FOUND;
+        }
+        else {
+            currentNum = boxes[currentNum]; // use number in box to search for next box
+        }
+    }
+    return NOT_FOUND; // exhausted all 50 boxes
+}
+
+void printStats(long sum, long n, char* caller) {
+    double mean = sum / (n + 0.0);
+    // standard variance formula = ( sigmaSum(x^2) * n*mean^2 ) / (n - 1)
+    // since sigmaSum(x^2) = sum because each simulation is a Bernoulli random variable,
+    // and mean = sum / n, then
+    // variance = (sum * (n*sum^2)/n^2) / (n-1) = (sum * sum^2/n) / (n-1) = (sum*(1 - mean))/(n-1)
+    double var = (sum*(1 - mean))/(n-1);
+    printf("\nStatistics of %s:\n", caller);
+    printf("Number of simulations: %ld\n", n);
+    printf("Parameter Estimate = %f\n", mean);
+    printf("Variance is %f\n", var);
+    printf("95%% CI: {%f, %f}\n",
+           mean - 1.96*sqrt(var/n),
+           mean + 1.96*sqrt(var/n));
+}
+
+enum found_t single_simulation(set_union* s, int size, int maxTrials) {
+    int currentIndex = size - 1;
+    int randomIndex;
+
+    set_union_init(s, size);
+    while (currentIndex > 0) {
+        randomIndex = randomInt(currentIndex);
+
+        union_set(s, currentIndex, randomIndex);
+        if (s->size[find(s, currentIndex)] > maxTrials) {
+            return NOT_FOUND;
+        }
+
+        currentIndex--;
+    }
+    return FOUND;
+}
+
+enum found_t runPackedSimulation(struct workspace* w, int maxTrials) {
+    packed_array* boxes = &w->perm;
+    long size = w->size;
+
+    for (long i=0; i<size; i++) {
+        packed_set(boxes, i, i);
+    }
+    randomizePackedArray(boxes);
+
+    // walk every cycle once, marking the boxes already visited
+    memset(w->visited, 0, sizeof(uint64_t)*(size/64 + 1));
+    for (long i=0; i<size; i++) {
+        if (bitset_test(w->visited, i)) continue;
+
+        long length = 0;
+        long currentNum = i;
+        do {
+            bitset_set(w->visited, currentNum);
+            currentNum = packed_get(boxes, currentNum);
+            if (++length > maxTrials) {
+                return NOT_FOUND;
+            }
+        } while (currentNum != i);
+    }
+    return FOUND;
+}
+
+enum found_t runPrefetchSimulation(struct workspace* w, int maxTrials) {
+    int* boxes = w->boxes;
+    int* lengths = w->lengths;
+    const int size = w->size;
+    const int flags = PREFETCH_WALKED | PREFETCH_START;
+    int start[PREFETCH_CURSORS], current[PREFETCH_CURSORS], length[PREFETCH_CURSORS];
+    int active = 0, next = 0;
+
+    for (int i=0; i<size; i++) {
+        boxes[i] = i;
+    }
+    randomizeArray(boxes, size);
+
+    // a box ahead of a cursor was either not walked yet or starts a segment,
+    // since only the cursor behind it can walk it, so cursors stop at the
+    // first box flagged as walked
+    for (;;) {
+        // start idle cursors on the next boxes not walked yet
+        for (; active < PREFETCH_CURSORS && next < size; next++) {
+            if (boxes[next] & PREFETCH_WALKED) continue;
+            start[active] = next;
+            current[active] = boxes[next];
+            length[active] = 1;
+            boxes[next] |= flags;
+            __builtin_prefetch(&boxes[current[active]]);
+            active++;
+        }
+        if (active == 0) break;
+
+        for (int c=0; c<active; ) {
+            int box = boxes[current[c]];
+            if (box & PREFETCH_WALKED) { // reached the start of a segment
+                boxes[start[c]] = flags | current[c];
+                lengths[start[c]] = length[c];
+                active--;
+                start[c] = start[active];
+                current[c] = current[active];
+                length[c] = length[active];
+                continue;
+            }
+            if (++length[c] > maxTrials) {
+                return NOT_FOUND;
+            }
+            boxes[current[c]] = box | PREFETCH_WALKED;
+            current[c] = box;
+            __builtin_prefetch(&boxes[box]);
+            c++;
+        }
+    }
+
+    // every segment now links to the next one on its cycle
+    for (int i=0; i<size; i++) {
+        if (!(boxes[i] & PREFETCH_START)) continue;
+
+        long cycleLength = 0;
+        int segment = i;
+        do {
+            cycleLength += lengths[segment];
+            boxes[segment] &= ~PREFETCH_START;
+            segment = boxes[segment] & ~flags;
+        } while (segment != i);
+        if (cycleLength > maxTrials) {
+            return NOT_FOUND;
+        }
+    }
+    return FOUND;
+}
+
+/*
+ * Finds the root of x in a packed forest, roots have their top bit set
+ * and hold the size of their tree in the remaining bits.
+ */
+static long packedFind(packed_array* forest, long x) {
+    const uint64_t rootFlag = 1ULL << (forest->bits - 1);
+    uint64_t parent;
+
+    while (!((parent = packed_get(forest, x)) & rootFlag)) {
+        uint64_t grandParent = packed_get(forest, parent);
+        if (grandParent & rootFlag) return parent;
+        packed_set(forest, x, grandParent); // semi-path compression
+        x = grandParent;
+    }
+    return x;
+}
+
+enum found_t single_simulation_packed(packed_array* forest, int size, int maxTrials) {
+    const uint64_t rootFlag = 1ULL << (forest->bits - 1);
+    int currentIndex = size - 1;
+
+    for (long i=0; i<size; i++) {
+        packed_set(forest, i, rootFlag | 1); // every element is a set of size 1
+    }
+    while (currentIndex > 0) {
+        long r1 = packedFind(forest, currentIndex);
+        long r2 = packedFind(forest, randomInt(currentIndex));
+
+        if (r1 != r2) {
+            uint64_t size1 = packed_get(forest, r1) & ~rootFlag;
+            uint64_t size2 = packed_get(forest, r2) & ~rootFlag;
+            if (size1 + size2 > (uint64_t)maxTrials) {
+                return NOT_FOUND;
+            }
+            if (size1 >= size2) {
+                packed_set(forest, r1, rootFlag | (size1 + size2));
+                packed_set(forest, r2, r1);
+            }
+            else {
+                packed_set(forest, r2, rootFlag | (size1 + size2));
+                packed_set(forest, r1, r2);
+            }
+        }
+        currentIndex--;
+    }
+    return FOUND;
+}
+
+void randomizeArray(int* array, int size) {
+    int currentIndex = size - 1;
+    int randomIndex;
+    int toSwap;
+
+    while (currentIndex > 0) {
+        randomIndex = randomInt(currentIndex);
+
+        toSwap = array[randomIndex];
+        array[randomIndex] = array[currentIndex];
+        array[currentIndex] = toSwap;
+
+        currentIndex--;
+    }
+}
+
+void randomizePackedArray(packed_array* array) {
+    long currentIndex = array->n - 1;
+
+    while (currentIndex > 0) {
+        long randomIndex = randomInt(currentIndex);
+
+        uint64_t toSwap = packed_get(array, randomIndex);
+        packed_set(array, randomIndex, packed_get(array, currentIndex));
+        packed_set(array, currentIndex, toSwap);
+
+        currentIndex--;
+    }
+}
+
+/*
+ * Whether "value", uniform in [0, 2^bits), is in the last incomplete run of
+ * "range" values, whose values reducing it modulo range would favour.
+ */
+static inline int inLastRun(uint32_t value, uint32_t range, int bits) {
+    uint64_t n = 1ULL << bits;
+    return value >= n - range && value >= n - n % range;
+}
+
+static unsigned int drawInt(int currentIndex) {
+    // a 32 bit draw reduced to "range" values favours some of them by up
+    // to range/2^32: 10^-8 for 100 boxes, under 10^-6 below DRAW_EXACT_MIN,
+    // but about 5% at 10^8 boxes. From DRAW_EXACT_MIN on the draws are
+    // exact, and below it the streams of earlier runs are kept
+    uint32_t range = currentIndex + 1;
+    switch (prng) {
+    case PRNG_RANDOM: { // default c PRNG, 31 bits
+        int32_t randVal;
+        random_r(&randomData, &randVal);
+        while (range >= DRAW_EXACT_MIN && inLastRun(randVal, range, 31)) {
+            random_r(&randomData, &randVal);
+        }
+        return randVal % range;
+    }
+    case PRNG_MRG32K3A: // MRG32k3a PRNG
+        if (range >= DRAW_EXACT_MIN) { // a second draw fills in the steps of the first
+            double u = MRG32k3a();
+            return (u + MRG32k3a()/4294967088.0) * range;
+        }
+        return MRG32k3a() * range;
+    case PRNG_DSFMT: // dSFMT (successor of mersenne twister), 52 bits
+        return dsfmt_genrand_close_open(&dsfmt) * range;
+    default: { // Marsa Lfib4 PRNG
+        unsigned int randVal = Lfib4();
+        while (range >= DRAW_EXACT_MIN && inLastRun(randVal, range, 32)) {
+            randVal = Lfib4();
+        }
+        return randVal % range;
+    }
+    }
+}
+
+unsigned int randomInt(int currentIndex) {
+    switch (drawMode) {
+    case DRAW_REPLAY:
+        return draws[currentIndex];
+    case DRAW_REFLECT:
+        return currentIndex - draws[currentIndex];
+    case DRAW_RECORD:
+        lowestDrawn = currentIndex;
+        return draws[currentIndex] = drawInt(currentIndex);
+    default:
+        return drawInt(currentIndex);
+    }
+}
+
+void seed(void) {
+    seedStream(readSeed());
+}
+
+uint64_t readSeed(void) {
+    if (seedGiven) return fixedSeed;
+
+    FILE* urandom = fopen("/dev/urandom", "r");
+    if (urandom == NULL) {
+        perror("Couldn't open urandom file");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t seedVal;
+    if (fread(&seedVal, sizeof(seedVal), 1, urandom) == 0) {
+        perror("Couldn't read urandom file");
+        exit(EXIT_FAILURE);
+    }
+    fclose(urandom);
+    return seedVal;
+}
+
+uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t streamKey(uint64_t key, uint64_t index) {
+    uint64_t state = key ^ (index * 0xD1B54A32D192ED03ULL);
+    return splitmix64(&state);
+}
+
+void seedStream(uint64_t key) {
+    // expand the 64 bit key into as many seed values as the PRNG needs
+    uint64_t state = key;
+    switch (prng) {
+    case PRNG_RANDOM:
+        // initstate_r only takes 32 bits, so blocks of a long run would
+        // repeat: the whole state is filled from the key instead
+        if (randomData.state == NULL) {
+            initstate_r(0, (char*)randomState, sizeof(randomState), &randomData);
+        }
+        for (int i=0; i<randomData.rand_deg; i++) {
+            randomData.state[i] = (int32_t)splitmix64(&state);
+        }
+        randomData.state[0] |= 1; // an all even state would shorten the period
+        randomData.fptr = &randomData.state[randomData.rand_sep];
+        randomData.rptr = &randomData.state[0];
+        break;
+    case PRNG_MRG32K3A: {
+        unsigned int seeds[6];
+        for (int i=0; i<6; i++) {
+            seeds[i] = (unsigned int)splitmix64(&state);
+        }
+        mrg_seed_array(seeds);
+        break;
+    }
+    case PRNG_DSFMT: { // the whole key, dsfmt_init_gen_rand only takes 32 bits
+        uint32_t seeds[4];
+        for (int i=0; i<4; i+=2) {
+            uint64_t s = splitmix64(&state);
+            seeds[i] = (uint32_t)s;
+            seeds[i + 1] = (uint32_t)(s >> 32);
+        }
+        dsfmt_init_by_array(&dsfmt, seeds, 4);
+        break;
+    }
+    default: {
+        unsigned int seeds[1 << 8];
+        for (int i=0; i<(1 << 8); i++) {
+            seeds[i] = (unsigned int)splitmix64(&state);
+        }
+        Lfib4_seed((unsigned char)splitmix64(&state), seeds);
+        break;
+    }
+    }
+}
+
+void simulateAndStatsWithProcesses(int n, int numProcesses) {
+    uint64_t runSeed = readSeed();
+    double start = now();
+    int numChunks = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    struct chunk* chunks = malloc(sizeof(struct chunk)*numChunks);
+    if (chunks == NULL) {
+        perror("Couldn't allocate chunks");
+        exit(EXIT_FAILURE);
+    }
+
+    // the processes share the run's stream, claiming a chunk of it at a time
+    for (int i=0; i<numChunks; i++) {
+        long first = (long)i*CHUNK_SIZE;
+        chunks[i] = (struct chunk){trialsPerPrisoner, first,
+                                   n - first < CHUNK_SIZE ? n - first : CHUNK_SIZE, 0, defaultPrng, 0};
+    }
+    struct cycleHistograms hist = {0};
+    startTrace(numProcesses, "Process");
+    simulateChunksWithProcesses(chunks, numChunks, numProcesses, runSeed, &hist, trialsPerPrisoner);
+
+    long sum = 0, both = 0;
+    for (int i=0; i<numChunks; i++) {
+        sum += chunks[i].successes;
+        both += chunks[i].bothSucceeded;
+    }
+    free(chunks);
+    reportRun(sum, both, n, runSeed, now() - start, histograms ? &hist : NULL, "All processes");
+}
+
+void initWorkspace(struct workspace* w, int size) {
+    if (w->size == 0) arena_init(&w->a);
+
+    // only map the buffers the kernel uses, plus a cache line of padding for each
+    int permBits = packed_bits_for(size - 1);
+    int forestBits = packed_bits_for(size) + 1; // plus the root flag
+    size_t bytes;
+    switch (method) {
+    case METHOD_NAIVE:
+        bytes = sizeof(int)*size + 64;
+        break;
+    case METHOD_PACKED:
+        bytes = packed_bytes(size, permBits) + sizeof(uint64_t)*(size/64 + 1) + 2*64;
+        break;
+    case METHOD_PACKED_UNION:
+        bytes = packed_bytes(size, forestBits) + 64;
+        break;
+    case METHOD_PREFETCH:
+        if (size >= PREFETCH_MAX_PRISONERS) {
+            fprintf(stderr, "The prefetch kernel needs less than %d prisoners\n", PREFETCH_MAX_PRISONERS);
+            exit(EXIT_FAILURE);
+        }
+        bytes = 2*(sizeof(int)*size + 64);
+        break;
+    default:
+        bytes = 2*(sizeof(int)*size + 64);
+        break;
+    }
+    if (antithetic || histograms) bytes += sizeof(int)*size + 64;
+    if (histograms) {
+        bytes += sizeof(struct cycleHistograms) + sizeof(int)*size +
+                 sizeof(uint64_t)*(size/64 + 1) + 3*64;
+    }
+    if (arena_reserve(&w->a, bytes) != 0) {
+        perror("Couldn't map simulation buffers");
+        exit(EXIT_FAILURE);
+    }
+    arena_reset(&w->a);
+
+    switch (method) {
+    case METHOD_NAIVE:
+        w->boxes = arena_alloc(&w->a, sizeof(int)*size);
+        break;
+    case METHOD_PACKED:
+        packed_init(&w->perm, arena_alloc(&w->a, packed_bytes(size, permBits)), size, permBits);
+        w->visited = arena_alloc(&w->a, sizeof(uint64_t)*(size/64 + 1));
+        break;
+    case METHOD_PACKED_UNION:
+        packed_init(&w->forest, arena_alloc(&w->a, packed_bytes(size, forestBits)), size, forestBits);
+        break;
+    case METHOD_PREFETCH:
+        w->boxes = arena_alloc(&w->a, sizeof(int)*size);
+        w->lengths = arena_alloc(&w->a, sizeof(int)*size);
+        break;
+    default:
+        w->s.p = arena_alloc(&w->a, sizeof(int)*size);
+        w->s.size = arena_alloc(&w->a, sizeof(int)*size);
+        break;
+    }
+    w->draws = antithetic || histograms ? arena_alloc(&w->a, sizeof(int)*size) : NULL;
+    if (histograms) {
+        w->hist = arena_alloc(&w->a, sizeof(struct cycleHistograms));
+        w->cycleBoxes = arena_alloc(&w->a, sizeof(int)*size);
+        w->cycleVisited = arena_alloc(&w->a, sizeof(uint64_t)*(size/64 + 1));
+    }
+    w->size = size;
+}
+
+/*
+ * Adds the longest cycle and the number of cycles of trial t to w->hist,
+ * by shuffling the boxes again with the numbers the trial drew. A kernel
+ * stopping early only drew the first of them, the rest come from a stream
+ * keyed by the trial so the run's stream is the same as without -H.
+ */
+static void recordCycles(struct workspace* w, uint64_t key, long t) {
+    int size = w->size, longest = 0, numCycles = 0;
+
+    if (drawMode == DRAW_RECORD) {
+        uint64_t state = streamKey(key ^ CYCLES_STREAM, t);
+        for (int i=lowestDrawn-1; i>0; i--) {
+            draws[i] = splitmix64(&state) % (i + 1);
+        }
+        drawMode = DRAW_REPLAY;
+    }
+    for (int i=0; i<size; i++) {
+        w->cycleBoxes[i] = i;
+    }
+    randomizeArray(w->cycleBoxes, size);
+
+    memset(w->cycleVisited, 0, sizeof(uint64_t)*(size/64 + 1));
+    for (int i=0; i<size; i++) {
+        if (bitset_test(w->cycleVisited, i)) continue;
+
+        int length = 0;
+        int currentNum = i;
+        do {
+            bitset_set(w->cycleVisited, currentNum);
+            currentNum = w->cycleBoxes[currentNum];
+            length++;
+        } while (currentNum != i);
+        if (length > longest) longest = length;
+        numCycles++;
+    }
+    histogram_add(&w->hist->longest, longest);
+    histogram_add(&w->hist->cycles, numCycles);
+}
+
+int simulateChunk(const struct chunk* c, struct workspace* w, uint64_t key, int* bothSucceeded) {
+    int sum = 0, both = 0;
+    enum found_t previous = NOT_FOUND;
+    traceEvent(TRACE_CHUNK_BEGIN, c->firstTrial);
+    prng = c->prng;
+    draws = w->draws;
+    if (histograms) {
+        histogram_clear(&w->hist->longest);
+        histogram_clear(&w->hist->cycles);
+    }
+    for (long t = c->firstTrial; t < c->firstTrial + c->numSimulations; t++) {
+        if (t == c->firstTrial || t % TRIAL_BLOCK == 0) {
+            traceEvent(TRACE_REFILL, t / TRIAL_BLOCK);
+            seedStream(streamKey(key, t / TRIAL_BLOCK));
+        }
+        // chunks and blocks start on an even trial, so pairs are never split
+        if (antithetic && t % 2 == 0) {
+            for (int i=w->size-1; i>0; i--) {
+                draws[i] = drawInt(i);
+            }
+            drawMode = DRAW_REPLAY;
+        }
+        else if (antithetic) {
+            drawMode = DRAW_REFLECT;
+        }
+        else if (histograms) {
+            drawMode = DRAW_RECORD;
+            lowestDrawn = w->size;
+        }
+
+        enum found_t found = runKernel(w, c->maxTrials);
+        if (histograms) recordCycles(w, key, t);
+        if (t % 2 == 1 && found == FOUND && previous == FOUND) both++;
+        previous = found;
+        sum += found;
+    }
+    drawMode = DRAW_FRESH;
+    traceEvent(TRACE_CHUNK_END, c->numSimulations);
+    if (bothSucceeded != NULL) *bothSucceeded = both;
+    return sum;
+}
+
+static struct chunkQueue* jobQueue(struct processJob* job) {
+    return (struct chunkQueue*)((char*)job + job->queueOffset);
+}
+
+static struct cycleHistograms* jobHistograms(struct processJob* job, int worker) {
+    return (struct cycleHistograms*)((char*)job + job->histogramsOffset) + (size_t)worker*job->numSlots;
+}
+
+/*
+ * Creates the memfd region of a run with room for "capacity" chunks, queues
+ * the first numChunks of them and maps it, returns the memfd in *fd.
+ */
+static struct processJob* createProcessJob(const struct chunk* chunks, int numChunks, int capacity,
+                                           int numProcesses, uint64_t runSeed, int numSlots, int kMin,
+                                           int open, int* fd) {
+    // cache line aligned parts, so workers never share a line across them
+    size_t workersSize = sizeof(struct processJob) + sizeof(struct workerSlot)*numProcesses;
+    size_t histogramsOffset = (workersSize + 63) & ~(size_t)63;
+    size_t histogramsSize = sizeof(struct cycleHistograms)*numSlots*numProcesses;
+    size_t queueOffset = (histogramsOffset + histogramsSize + 63) & ~(size_t)63;
+    size_t size = queueOffset + sizeof(struct chunkQueue) + sizeof(struct queuedChunk)*capacity;
+
+    // not close on exec, spawned workers find it by its number
+    *fd = memfd_create("100prisoners-job", 0);
+    if (*fd < 0 || ftruncate(*fd, size) != 0) {
+        perror("Couldn't create the job's memfd");
+        exit(EXIT_FAILURE);
+    }
+    struct processJob* job = mmap(NULL, size, PROT_WRITE|PROT_READ, MAP_SHARED, *fd, 0);
+    if (job == MAP_FAILED) {
+        perror("mmap failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // the memfd starts zeroed, only the nonzero fields are set
+    job->size = size;
+    job->histogramsOffset = numSlots > 0 ? histogramsOffset : 0;
+    job->queueOffset = queueOffset;
+    job->runSeed = runSeed;
+    job->numPrisoners = numPrisoners;
+    job->method = method;
+    job->antithetic = antithetic;
+    job->histograms = histograms;
+    job->kMin = kMin;
+    job->numSlots = numSlots;
+    job->numProcesses = numProcesses;
+    job->open = open;
+
+    struct chunkQueue* q = jobQueue(job);
+    q->numChunks = numChunks;
+    for (int i=0; i<numChunks; i++) {
+        q->chunks[i].c = chunks[i];
+        q->chunks[i].state = CHUNK_PENDING;
+    }
+    return job;
+}
+
+/*
+ * Body of a worker process, forked or spawned.
+ */
+static void workOnJob(struct processJob* job, int worker) {
+    traceWorker = worker;
+    numPrisoners = job->numPrisoners;
+    method = job->method;
+    antithetic = job->antithetic;
+    histograms = job->histograms;
+
+    // map the buffers in the worker, so they are local to its node
+    initWorkspace(&workerSpace, numPrisoners);
+    processChunks(job, worker);
+    exit(EXIT_SUCCESS);
+}
+
+void runWorker(int fd, int worker) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("Couldn't read the job's memfd");
+        exit(EXIT_FAILURE);
+    }
+    struct processJob* job = mmap(NULL, st.st_size, PROT_WRITE|PROT_READ, MAP_SHARED, fd, 0);
+    if (job == MAP_FAILED) {
+        perror("mmap failed");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    if (worker < 0 || worker >= job->numProcesses) {
+        fprintf(stderr, "No worker %d in the job\n", worker);
+        exit(EXIT_FAILURE);
+    }
+    workOnJob(job, worker);
+}
+
+/*
+ * Creates the region of a run and starts its workers on the chunks queued
+ * in it, forking them or spawning them with --spawn.
+ */
+static struct processJob* startProcessJob(struct chunk* chunks, int numChunks, int capacity,
+                                          int numProcesses, uint64_t runSeed, int numSlots, int kMin,
+                                          int open) {
+    int fd;
+    struct processJob* job = createProcessJob(chunks, numChunks, capacity, numProcesses, runSeed,
+                                              numSlots, kMin, open, &fd);
+
+    // spawned workers start from scratch with the path of this executable,
+    // and only get the region, so their timeline is not traced
+    char workerArg[32];
+    char* workerArgv[] = {"100prisoners", "--worker", workerArg, NULL};
+
+    for (int i=0; i<numProcesses; i++) {
+        pid_t pid;
+        if (spawnWorkers) {
+            snprintf(workerArg, sizeof(workerArg), "%d:%d", fd, i);
+            int error = posix_spawn(&pid, "/proc/self/exe", NULL, NULL, workerArgv, environ);
+            if (error != 0) {
+                fprintf(stderr, "spawn failed: %s\n", strerror(error));
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if ((pid = fork()) == 0) { // children claim chunks until every chunk is done
+            workOnJob(job, i);
+        }
+        else if (pid < 0) {
+            perror("fork failed");
+            exit(EXIT_FAILURE);
+        }
+        job->workers[i].pid = pid;
+    }
+    close(fd);
+    return job;
+}
+
+/*
+ * Forgets the worker "pid" the parent reaped, reporting it if it exited
+ * before every chunk was done.
+ */
+static void reapWorker(struct processJob* job, int pid, int done) {
+    for (int i=0; i<job->numProcesses; i++) {
+        struct workerSlot* slot = &job->workers[i];
+        if (slot->pid != pid) continue;
+        slot->pid = 0; // a pid no longer ours may belong to another process by now
+        if (!done) {
+            fprintf(stderr, "Worker %d died after %d chunks\n", i, slot->chunks);
+            job->died++;
+        }
+    }
+}
+
+static void exitIfUnfinished(struct chunkQueue* q) {
+    if (q->done != q->numChunks) { // every worker died before the end
+        fprintf(stderr, "Only %d of %d chunks were simulated\n", q->done, q->numChunks);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * Adds a round of chunks to the queue of an open job and waits until its
+ * workers are done with them, then stores their results back in chunks[].
+ * The workers wait for the next round rather than exit, so the parent
+ * polls for the end of the round.
+ */
+static void simulateRound(struct processJob* job, struct chunk* chunks, int numChunks) {
+    struct chunkQueue* q = jobQueue(job);
+    int first = q->numChunks;
+    for (int i=0; i<numChunks; i++) {
+        q->chunks[first + i].c = chunks[i];
+        q->chunks[first + i].state = CHUNK_PENDING;
+    }
+    __atomic_store_n(&q->first, first, __ATOMIC_RELAXED);
+    __atomic_store_n(&q->numChunks, first + numChunks, __ATOMIC_RELEASE);
+
+    traceEvent(TRACE_STALL_BEGIN, 0);
+    while (__atomic_load_n(&q->done, __ATOMIC_ACQUIRE) < first + numChunks) {
+        int pid = waitpid(-1, NULL, WNOHANG);
+        if (pid > 0) reapWorker(job, pid, 0);
+        else if (pid < 0) exitIfUnfinished(q);
+        else nanosleep(&(struct timespec){0, STRAGGLER_POLL_NS}, NULL);
+    }
+    traceEvent(TRACE_STALL_END, 0);
+
+    for (int i=0; i<numChunks; i++) {
+        chunks[i].successes = q->chunks[first + i].c.successes;
+        chunks[i].bothSucceeded = q->chunks[first + i].c.bothSucceeded;
+    }
+}
+
+/*
+ * Closes the queue of a job and waits for its workers to exit, then adds
+ * their histograms to hist and reports them. The results of the chunks
+ * stay in the queue until the job is unmapped.
+ */
+static void finishProcessJob(struct processJob* job, struct cycleHistograms* hist) {
+    struct chunkQueue* q = jobQueue(job);
+    int numProcesses = job->numProcesses;
+    __atomic_store_n(&job->open, 0, __ATOMIC_RELEASE);
+
+    // a child only exits once every chunk is done, so after the first exit
+    // the children left are stragglers whose result is not needed anymore,
+    // and one exiting before died. While publishing, the parent polls
+    // instead, publishing in between
+    traceEvent(TRACE_STALL_BEGIN, 0);
+    int pid;
+    while ((pid = live.segment != NULL ? waitpid(-1, NULL, WNOHANG) : wait(NULL)) >= 0) {
+        if (pid == 0) {
+            publishProgress(q, 0);
+            nanosleep(&(struct timespec){0, PUBLISH_INTERVAL_NS}, NULL);
+            continue;
+        }
+        int done = __atomic_load_n(&q->done, __ATOMIC_ACQUIRE) == q->numChunks;
+        reapWorker(job, pid, done);
+        if (done) {
+            for (int i=0; i<numProcesses; i++) {
+                if (job->workers[i].pid != 0) kill(job->workers[i].pid, SIGKILL);
+            }
+        }
+    }
+    traceEvent(TRACE_STALL_END, 0);
+    exitIfUnfinished(q);
+
+    long simulated = 0, simulations = 0;
+    for (int i=0; i<q->numChunks; i++) {
+        simulations += q->chunks[i].c.numSimulations;
+    }
+    publishProgress(q, 1);
+    for (int i=0; i<numProcesses; i++) {
+        simulated += job->workers[i].simulations;
+        for (int k=0; k<job->numSlots; k++) {
+            histogram_merge(&hist[k].longest, &jobHistograms(job, i)[k].longest);
+            histogram_merge(&hist[k].cycles, &jobHistograms(job, i)[k].cycles);
+        }
+    }
+    if (job->died > 0) {
+        printf("Workers that died: %d of %d, the others simulated their chunks\n", job->died, numProcesses);
+    }
+    if (q->speculated > 0) {
+        printf("Straggling chunks copied: %d, copies finished first: %d, simulations wasted: %ld\n",
+               q->speculated, q->speculativeWins, simulated > simulations ? simulated - simulations : 0);
+    }
+}
+
+void simulateChunksWithProcesses(struct chunk* chunks, int numChunks, int numProcesses,
+                                 uint64_t runSeed, struct cycleHistograms* hist, int kMin) {
+    // histograms of every worker, for every maxTrials of the chunks
+    int numSlots = 0;
+    if (histograms && hist != NULL) {
+        for (int i=0; i<numChunks; i++) {
+            if (chunks[i].maxTrials - kMin + 1 > numSlots) numSlots = chunks[i].maxTrials - kMin + 1;
+        }
+    }
+    struct processJob* job = startProcessJob(chunks, numChunks, numChunks, numProcesses, runSeed,
+                                             numSlots, kMin, 0);
+    finishProcessJob(job, hist);
+
+    struct chunkQueue* q = jobQueue(job);
+    for (int i=0; i<numChunks; i++) {
+        chunks[i].successes = q->chunks[i].c.successes;
+        chunks[i].bothSucceeded = q->chunks[i].c.bothSucceeded;
+    }
+    munmap(job, job->size);
+}
+
+/*
+ * Finds a chunk of the latest round running for long enough to start a
+ * second copy of it, returns -1 if there is none.
+ */
+static int findStraggler(struct chunkQueue* q, int numChunks) {
+    int done = __atomic_load_n(&q->done, __ATOMIC_ACQUIRE);
+    if (done == 0) return -1; // no idea yet of how long a chunk takes
+
+    double threshold = STRAGGLER_FACTOR * __atomic_load_n(&q->doneNanos, __ATOMIC_RELAXED)*1e-9 / done;
+    double t = now();
+    int oldest = -1;
+    for (int i=__atomic_load_n(&q->first, __ATOMIC_RELAXED); i<numChunks; i++) {
+        struct queuedChunk* qc = &q->chunks[i];
+        if (__atomic_load_n(&qc->state, __ATOMIC_ACQUIRE) == CHUNK_RUNNING &&
+            qc->copies == 1 && t - qc->claimed > threshold &&
+            (oldest < 0 || qc->claimed < q->chunks[oldest].claimed)) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+void processChunks(struct processJob* job, int worker) {
+    struct chunkQueue* q = jobQueue(job);
+    struct workerSlot* self = &job->workers[worker];
+    int stalled = 0;
+
+    for (;;) {
+        int numChunks = __atomic_load_n(&q->numChunks, __ATOMIC_ACQUIRE);
+        int speculative = 0;
+        int c = __atomic_load_n(&q->next, __ATOMIC_RELAXED);
+        // claims never go past the end of the queue, where the parent of
+        // an open job adds the next round
+        while (c < numChunks && !__atomic_compare_exchange_n(&q->next, &c, c + 1, 1,
+                                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+        if (c < numChunks) {
+            q->chunks[c].claimed = now();
+            q->chunks[c].copies = 1;
+            __atomic_store_n(&q->chunks[c].state, CHUNK_RUNNING, __ATOMIC_RELEASE);
+        }
+        else { // nothing left to claim, help with the oldest straggler
+            if (__atomic_load_n(&q->done, __ATOMIC_ACQUIRE) >= numChunks &&
+                !__atomic_load_n(&job->open, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            int one = 1;
+            c = findStraggler(q, numChunks);
+            if (c < 0 || !__atomic_compare_exchange_n(&q->chunks[c].copies, &one, 2, 0,
+                                                      __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                if (!stalled) traceEvent(TRACE_STALL_BEGIN, 0);
+                stalled = 1;
+                nanosleep(&(struct timespec){0, STRAGGLER_POLL_NS}, NULL);
+                continue;
+            }
+            __atomic_fetch_add(&q->speculated, 1, __ATOMIC_RELAXED);
+            speculative = 1;
+        }
+        if (stalled) traceEvent(TRACE_STALL_END, 0);
+        stalled = 0;
+
+        struct queuedChunk* qc = &q->chunks[c];
+        int bothSucceeded;
+        int successes = simulateChunk(&qc->c, &workerSpace, streamKey(job->runSeed, qc->c.maxTrials),
+                                      &bothSucceeded);
+        self->chunks++;
+        self->simulations += qc->c.numSimulations;
+
+        // both copies give the same result, keep whichever finished first.
+        // The chunk is only marked done once its results are written, for
+        // the parent publishing them while workers run
+        int running = CHUNK_RUNNING;
+        if (__atomic_compare_exchange_n(&qc->state, &running, CHUNK_SAVING, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            qc->c.successes = successes;
+            qc->c.bothSucceeded = bothSucceeded;
+            __atomic_store_n(&qc->state, CHUNK_DONE, __ATOMIC_RELEASE);
+            if (job->numSlots > 0) {
+                struct cycleHistograms* h = &jobHistograms(job, worker)[qc->c.maxTrials - job->kMin];
+                histogram_merge(&h->longest, &workerSpace.hist->longest);
+                histogram_merge(&h->cycles, &workerSpace.hist->cycles);
+            }
+            if (speculative) __atomic_fetch_add(&q->speculativeWins, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&q->doneNanos, (uint64_t)((now() - qc->claimed)*1e9),
+                               __ATOMIC_RELAXED);
+            __atomic_fetch_add(&q->done, 1, __ATOMIC_RELEASE);
+        }
+    }
+    if (stalled) traceEvent(TRACE_STALL_END, 0);
+}
+
+double estimatedHalfWidth(long successes, long n) {
+    // smooth the estimate so points with p close to 0 or 1 are not
+    // considered precise after only a few simulations
+    double p = (successes + 1.0) / (n + 2.0);
+    return 1.96*sqrt(p*(1 - p)/(n + 2.0));
+}
+
+void sweepWithProcesses(int kMin, int kMax, double halfWidth,
+                        long budget, int numProcesses) {
+    int numPoints = kMax - kMin + 1;
+    int maxChunks = numProcesses*CHUNKS_PER_WORKER;
+    if (maxChunks < numPoints) maxChunks = numPoints;
+    // sized by the -K range, too large for the stack
+    struct sweepPoint* points = calloc(numPoints, sizeof(struct sweepPoint));
+    struct chunk* chunks = calloc(maxChunks, sizeof(struct chunk));
+    long* planned = calloc(numPoints, sizeof(long));
+    if (points == NULL || chunks == NULL || planned == NULL) {
+        perror("Couldn't allocate the sweep");
+        exit(EXIT_FAILURE);
+    }
+    struct cycleHistograms* hist = NULL;
+    if (histograms && (hist = calloc(numPoints, sizeof(struct cycleHistograms))) == NULL) {
+        perror("Couldn't allocate histograms");
+        exit(EXIT_FAILURE);
+    }
+    long spent = 0;
+    int pilots = 0; // points without stored results
+    uint64_t runSeed = readSeed();
+    double start = now();
+    startTrace(numProcesses, "Process");
+
+    for (int i=0; i<numPoints; i++) {
+        points[i].maxTrials = kMin + i;
+        points[i].simulations = 0;
+        points[i].successes = 0;
+        points[i].previousSimulations = 0;
+        points[i].previousSuccesses = 0;
+        if (resumeResults) { // only spend simulations where the stored CI is too wide
+            storedResults(numPrisoners, points[i].maxTrials,
+                          &points[i].previousSimulations, &points[i].previousSuccesses);
+        }
+        if (points[i].previousSimulations == 0) pilots++;
+    }
+    if ((long)pilots*CHUNK_SIZE > budget) {
+        fprintf(stderr, "A sweep of %d points needs at least %ld simulations, one chunk per point\n",
+                pilots, (long)pilots*CHUNK_SIZE);
+        exit(EXIT_FAILURE);
+    }
+
+    // every chunk but the last one is whole, so the queue holds them all
+    struct processJob* job = startProcessJob(NULL, 0, budget/CHUNK_SIZE + 1, numProcesses, runSeed,
+                                             hist != NULL ? numPoints : 0, kMin, 1);
+
+    int round = 0;
+    while (spent < budget) {
+        int numChunks = 0;
+        memset(planned, 0, sizeof(long)*numPoints);
+
+        if (round == 0) { // pilot chunk at every point to get a first estimate
+            for (int i=0; i<numPoints; i++) { // the budget was checked to pay for them
+                if (points[i].previousSimulations > 0) continue;
+                planned[i] = CHUNK_SIZE;
+                chunks[numChunks++] = (struct chunk){points[i].maxTrials, 0, CHUNK_SIZE, 0,
+                                                     defaultPrng, 0};
+                spent += CHUNK_SIZE;
+            }
+        }
+        else { // give each chunk to the point whose CI will still be widest
+            while (numChunks < maxChunks && spent < budget) {
+                int widest = -1;
+                double widestHalfWidth = halfWidth;
+                for (int i=0; i<numPoints; i++) {
+                    double w = estimatedHalfWidth(points[i].successes + points[i].previousSuccesses,
+                                                  points[i].simulations + planned[i] +
+                                                  points[i].previousSimulations);
+                    if (w > widestHalfWidth) {
+                        widest = i;
+                        widestHalfWidth = w;
+                    }
+                }
+                if (widest < 0) break; // every point meets the target
+
+                // the last chunk takes what is left of the budget, it is the
+                // last one of its point so the next never starts mid block
+                long size = budget - spent < CHUNK_SIZE ? budget - spent : CHUNK_SIZE;
+                chunks[numChunks++] = (struct chunk){points[widest].maxTrials,
+                                                     points[widest].simulations + planned[widest],
+                                                     size, 0, defaultPrng, 0};
+                planned[widest] += size;
+                spent += size;
+            }
+        }
+        if (numChunks == 0) {
+            if (round++ == 0) continue; // every point already had stored results
+            break;
+        }
+
+        simulateRound(job, chunks, numChunks);
+        for (int c=0; c<numChunks; c++) {
+            struct sweepPoint* point = &points[chunks[c].maxTrials - kMin];
+            point->simulations += chunks[c].numSimulations;
+            point->successes += chunks[c].successes;
+        }
+        round++;
+    }
+    finishProcessJob(job, hist);
+    munmap(job, job->size);
+
+    // every point is stored as a run of its own
+    double seconds = now() - start;
+    for (int i=0; i<numPoints; i++) {
+        if (points[i].simulations > 0) {
+            saveResult(numPrisoners, points[i].maxTrials, defaultPrng, runSeed, points[i].simulations,
+                       points[i].successes, seconds, hist != NULL ? &hist[i] : NULL);
+        }
+        points[i].simulations += points[i].previousSimulations;
+        points[i].successes += points[i].previousSuccesses;
+    }
+
+    printf("\nStatistics of sweep (target 95%% CI half width %g):\n", halfWidth);
+    printf("%6s %12s %12s %25s %12s\n", "Boxes", "Simulations", "Estimate", "95% CI", "Half width");
+    for (int i=0; i<numPoints; i++) {
+        long n = points[i].simulations;
+        double mean = n ? points[i].successes / (n + 0.0) : 0;
+        // the same half width the chunks were allocated with, so a point is
+        // only flagged if its printed width misses the target, around the
+        // smoothed estimate it is computed from
+        double w = estimatedHalfWidth(points[i].successes, n);
+        double smoothed = (points[i].successes + 1.0) / (n + 2.0);
+        printf("%6d %12ld %12f     {%f, %f} %12f%s\n", points[i].maxTrials, n, mean,
+               fmax(smoothed - w, 0), fmin(smoothed + w, 1), w, w > halfWidth ? " (budget exhausted)" : "");
+    }
+    printf("Total number of simulations: %ld\n", spent);
+
+    if (hist != NULL) {
+        // the cycles do not depend on the boxes opened, but every point has its own trials
+        printf("\nCycles of the trials of every point:\n");
+        printf("%6s %12s %12s %6s %6s %6s %12s %6s %6s\n", "Boxes", "Simulations",
+               "Mean longest", "Median", "99%", "Max", "Mean cycles", "Median", "Max");
+        for (int i=0; i<numPoints; i++) {
+            if (hist[i].longest.total == 0) continue;
+            printf("%6d %12lu %12.2f %6u %6u %6u %12.3f %6u %6u\n", points[i].maxTrials,
+                   (unsigned long)hist[i].longest.total, histogram_mean(&hist[i].longest),
+                   histogram_quantile(&hist[i].longest, 0.5), histogram_quantile(&hist[i].longest, 0.99),
+                   histogram_quantile(&hist[i].longest, 1), histogram_mean(&hist[i].cycles),
+                   histogram_quantile(&hist[i].cycles, 0.5), histogram_quantile(&hist[i].cycles, 1));
+        }
+        free(hist);
+    }
+    free(planned);
+    free(chunks);
+    free(points);
+}
+
+enum job_state resumeSimJob(struct job* j) {
+    struct simJob* job = (struct simJob*)j;
+    long remaining = job->numSimulations - job->done;
+    struct chunk c = {job->maxTrials, job->firstTrial + job->done,
+                      remaining < CHUNK_SIZE ? remaining : CHUNK_SIZE, 0, defaultPrng, 0};
+
+    initWorkspace(&workerSpace, job->numPrisoners);
+    int both;
+    job->successes += simulateChunk(&c, &workerSpace, job->key, &both);
+    job->bothSucceeded += both;
+    job->done += c.numSimulations;
+    if (job->done < job->numSimulations) {
+        return JOB_YIELD; // let the other jobs run before the next chunk
+    }
+
+    if (job->onDone != NULL) job->onDone(job);
+    return JOB_DONE;
+}
+
+void initSimJob(struct simJob* job, int numPrisoners, int maxTrials,
+                long firstTrial, long numSimulations, uint64_t seed) {
+    job->base.resume = resumeSimJob;
+    job->numPrisoners = numPrisoners;
+    job->maxTrials = maxTrials;
+    job->firstTrial = firstTrial;
+    job->numSimulations = numSimulations;
+    job->done = 0;
+    job->successes = 0;
+    job->bothSucceeded = 0;
+    job->seed = seed;
+    job->key = streamKey(seed, maxTrials);
+    job->onDone = NULL;
+}
+
+void simulateSequentially(int n) {
+    uint64_t runSeed = readSeed();
+    double start = now();
+    struct chunk c = {trialsPerPrisoner, 0, n, 0, defaultPrng, 0};
+
+    startTrace(0, NULL);
+    initWorkspace(&workerSpace, numPrisoners);
+    int both;
+    int sum = simulateChunk(&c, &workerSpace, streamKey(runSeed, trialsPerPrisoner), &both);
+    reportRun(sum, both, n, runSeed, now() - start, histograms ? workerSpace.hist : NULL,
+              "Sequence (Single Thread / Process)");
+}
+
+void simulateAndStatsWithThreads(int n, int numThreads) {
+    executor e;
+    struct simJob jobs[numThreads];
+    uint64_t runSeed = readSeed();
+    double start = now();
+    long sum = 0, both = 0;
+
+    // every thread simulates a share of the run's stream, made of whole
+    // blocks so the stream is the same as in a sequential run
+    long blocks = (n + TRIAL_BLOCK - 1) / TRIAL_BLOCK;
+    long share = (blocks + numThreads - 1) / numThreads * TRIAL_BLOCK;
+
+    startTrace(numThreads, "Thread");
+    executor_init(&e, numThreads, &traceHooks);
+    for (int i=0; i<numThreads; i++) {
+        long first = share*i < n ? share*i : n;
+        long count = first + share < n ? share : n - first;
+        printf("Thread %d, number of simulations to perform: %ld\n", i + 1, count);
+        initSimJob(&jobs[i], numPrisoners, trialsPerPrisoner, first, count, runSeed);
+        if (count > 0) executor_submit(&e, &jobs[i].base);
+    }
+    traceEvent(TRACE_STALL_BEGIN, 0);
+    executor_wait(&e);
+    traceEvent(TRACE_STALL_END, 0);
+    executor_shutdown(&e);
+
+    for (int i=0; i<numThreads; i++) {
+        sum += jobs[i].successes;
+        both += jobs[i].bothSucceeded;
+    }
+    reportRun(sum, both, n, runSeed, now() - start, NULL, "All threads");
+}
+
+enum job_state resumeJointJob(struct job* j) {
+    struct jointJob* job = (struct jointJob*)j;
+    int size = job->numPrisoners;
+    long remaining = job->numSimulations - job->done;
+    long last = job->firstTrial + job->done + (remaining < CHUNK_SIZE ? remaining : CHUNK_SIZE);
+
+    prng = defaultPrng;
+    traceEvent(TRACE_CHUNK_BEGIN, job->firstTrial + job->done);
+    // shares start on a block, so every group of 64 trials is in one block
+    for (long t = job->firstTrial + job->done; t < last; t += 64) {
+        int numTrials = last - t < 64 ? last - t : 64;
+        memset(job->successes, 0, sizeof(uint64_t)*size);
+        for (int bit=0; bit<numTrials; bit++) {
+            if ((t + bit) % TRIAL_BLOCK == 0 || t + bit == job->firstTrial + job->done) {
+                traceEvent(TRACE_REFILL, (t + bit) / TRIAL_BLOCK);
+                seedStream(streamKey(job->key, (t + bit) / TRIAL_BLOCK));
+            }
+            for (int i=0; i<size; i++) {
+                job->boxes[i] = i;
+            }
+            randomizeArray(job->boxes, size);
+
+            // every prisoner on a cycle of at most maxTrials boxes finds his tag
+            memset(job->visited, 0, sizeof(uint64_t)*(size/64 + 1));
+            for (int i=0; i<size; i++) {
+                if (bitset_test(job->visited, i)) continue;
+
+                int length = 0;
+                int currentNum = i;
+                do {
+                    bitset_set(job->visited, currentNum);
+                    currentNum = job->boxes[currentNum];
+                    length++;
+                } while (currentNum != i);
+
+                if (length > job->maxTrials) continue;
+                do {
+                    job->successes[currentNum] |= 1ULL << bit;
+                    currentNum = job->boxes[currentNum];
+                } while (currentNum != i);
+            }
+        }
+        joint_add(&job->m, job->successes, numTrials);
+    }
+    traceEvent(TRACE_CHUNK_END, last - job->firstTrial - job->done);
+
+    job->done = last - job->firstTrial;
+    return job->done < job->numSimulations ? JOB_YIELD : JOB_DONE;
+}
+
+enum job_state mergeJointJob(struct job* j) {
+    struct jointJob* job = (struct jointJob*)j;
+    joint_merge(&job->m, &job->from->m);
+    joint_free(&job->from->m);
+    return JOB_DONE;
+}
+
+double exactJointProbability(int numPrisoners, int maxTrials) {
+    // the cycle of the first prisoner has length l with probability 1/n.
+    // The second one is on the same cycle with probability (l-1)/(n-1),
+    // otherwise his cycle is a cycle of a random permutation of the n-l
+    // other boxes, of length at most maxTrials with probability
+    // min(maxTrials, n-l)/(n-l)
+    double sum = 0;
+    for (int l=1; l<=maxTrials; l++) {
+        int others = numPrisoners - l;
+        sum += (l - 1) + (others < maxTrials ? others : maxTrials);
+    }
+    return numPrisoners > 1 ? sum / numPrisoners / (numPrisoners - 1) : 1;
+}
+
+static int writeJointMatrix(const joint_matrix* m, const char* path) {
+    FILE* f = fopen(path, "w");
+    if (f == NULL) return -1;
+
+    fprintf(f, "# %d prisoners, %d boxes, %ld trials\n", m->n, trialsPerPrisoner, m->trials);
+    for (int i=0; i<m->n; i++) {
+        for (int j=0; j<m->n; j++) {
+            fprintf(f, j == 0 ? "%u" : " %u", joint_count(m, i, j));
+        }
+        fputc('\n', f);
+    }
+    return fclose(f);
+}
+
+void jointWithThreads(int n, int numThreads) {
+    int size = numPrisoners;
+    if (size > JOINT_MAX_PRISONERS) {
+        fprintf(stderr, "At most %d prisoners in j mode\n", JOINT_MAX_PRISONERS);
+        exit(EXIT_FAILURE);
+    }
+
+    executor e;
+    struct jointJob jobs[numThreads];
+    uint64_t runSeed = readSeed();
+    double start = now();
+
+    // every thread simulates a share of the run's stream, made of whole blocks
+    long blocks = (n + TRIAL_BLOCK - 1) / TRIAL_BLOCK;
+    long share = (blocks + numThreads - 1) / numThreads * TRIAL_BLOCK;
+
+    startTrace(numThreads, "Thread");
+    executor_init(&e, numThreads, &traceHooks);
+    for (int i=0; i<numThreads; i++) {
+        struct jointJob* job = &jobs[i];
+        long first = share*i < n ? share*i : n;
+        job->base.resume = resumeJointJob;
+        job->numPrisoners = size;
+        job->maxTrials = trialsPerPrisoner;
+        job->firstTrial = first;
+        job->numSimulations = first + share < n ? share : n - first;
+        job->done = 0;
+        job->key = streamKey(runSeed, trialsPerPrisoner);
+        job->boxes = malloc(sizeof(int)*size);
+        job->visited = malloc(sizeof(uint64_t)*(size/64 + 1));
+        job->successes = malloc(sizeof(uint64_t)*size);
+        if (job->boxes == NULL || job->visited == NULL || job->successes == NULL ||
+            joint_init(&job->m, size) != 0) {
+            perror("Couldn't allocate joint success counts");
+            exit(EXIT_FAILURE);
+        }
+        if (job->numSimulations > 0) executor_submit(&e, &job->base);
+    }
+    traceEvent(TRACE_STALL_BEGIN, 0);
+    executor_wait(&e);
+
+    // merge the matrices in pairs, halving their number every round
+    for (int step=1; step<numThreads; step*=2) {
+        for (int i=0; i+step<numThreads; i+=2*step) {
+            jobs[i].base.resume = mergeJointJob;
+            jobs[i].from = &jobs[i + step];
+            executor_submit(&e, &jobs[i].base);
+        }
+        executor_wait(&e);
+    }
+    traceEvent(TRACE_STALL_END, 0);
+    executor_shutdown(&e);
+    for (int i=0; i<numThreads; i++) {
+        free(jobs[i].boxes);
+        free(jobs[i].visited);
+        free(jobs[i].successes);
+    }
+
+    joint_matrix* m = &jobs[0].m;
+    double single = trialsPerPrisoner / (size + 0.0); // his cycle's length is uniform
+    double exact = exactJointProbability(size, trialsPerPrisoner);
+    double singleSum = 0, jointSum = 0, covarianceSum = 0, maxZ = 0;
+    int maxI = 0, maxJ = 0;
+    long numPairs = (long)size*(size - 1)/2;
+    for (int i=0; i<size; i++) {
+        double pi = joint_count(m, i, i) / (n + 0.0);
+        singleSum += pi;
+        for (int j=i+1; j<size; j++) {
+            double pj = joint_count(m, j, j) / (n + 0.0);
+            double pij = joint_count(m, i, j) / (n + 0.0);
+            double z = exact > 0 && exact < 1 ?
+                       (pij - exact) / sqrt(exact*(1 - exact)/n) : 0;
+            jointSum += pij;
+            covarianceSum += pij - pi*pj;
+            if (fabs(z) > fabs(maxZ)) {
+                maxZ = z;
+                maxI = i;
+                maxJ = j;
+            }
+        }
+    }
+
+    printf("\nStatistics of joint success (%d prisoners, %d boxes, %ld simulations):\n",
+           size, trialsPerPrisoner, m->trials);
+    printf("Mean success of a prisoner = %f (exact %f)\n", singleSum / size, single);
+    if (numPairs > 0) {
+        printf("Mean joint success of a pair = %f (exact %f, %f if independent)\n",
+               jointSum / numPairs, exact, single*single);
+        printf("Mean covariance of a pair = %f (exact %f)\n",
+               covarianceSum / numPairs, exact - single*single);
+        printf("Largest deviation from exact: prisoners %d and %d, z = %f over %ld pairs\n",
+               maxI, maxJ, maxZ, numPairs);
+    }
+    printf("Time: %f s\n", now() - start);
+
+    if (jointPath != NULL && writeJointMatrix(m, jointPath) != 0) {
+        perror("Couldn't write joint success counts");
+    }
+    joint_free(m);
+}
+
+/*
+ * Parses a cpulist of /sys, like "0-3,8-11", into cpus.
+ */
+static void parseCpuList(const char* list, cpu_set_t* cpus) {
+    CPU_ZERO(cpus);
+    while (*list != '\0' && *list != '\n') {
+        char* end;
+        long first = strtol(list, &end, 10), last = first;
+        if (end == list) break;
+        if (*end == '-') last = strtol(end + 1, &end, 10);
+        for (long c=first; c<=last && c<CPU_SETSIZE; c++) {
+            CPU_SET(c, cpus);
+        }
+        list = *end == ',' ? end + 1 : end;
+    }
+}
+
+/*
+ * Finds the CPUs of every NUMA node the process may run on, from
+ * /sys/devices/system/node, or a single node with every allowed CPU if
+ * there is no NUMA information. Returns the number of nodes.
+ */
+static int numaNodes(cpu_set_t** nodes) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+        for (long c=0; c<sysconf(_SC_NPROCESSORS_ONLN) && c<CPU_SETSIZE; c++) {
+            CPU_SET(c, &allowed);
+        }
+    }
+
+    int numNodes = 0, capacity = 8;
+    *nodes = malloc(sizeof(cpu_set_t)*capacity);
+    if (*nodes == NULL) {
+        perror("Couldn't allocate the NUMA nodes");
+        exit(EXIT_FAILURE);
+    }
+    DIR* dir = opendir("/sys/devices/system/node");
+    struct dirent* entry;
+    while (dir != NULL && (entry = readdir(dir)) != NULL) {
+        int node;
+        char path[300], list[4096];
+        if (sscanf(entry->d_name, "node%d", &node) != 1) continue;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", entry->d_name);
+        FILE* f = fopen(path, "r");
+        if (f == NULL) continue;
+        int read = fgets(list, sizeof(list), f) != NULL;
+        fclose(f);
+        if (!read) continue;
+
+        if (numNodes == capacity) {
+            capacity *= 2;
+            cpu_set_t* grown = realloc(*nodes, sizeof(cpu_set_t)*capacity);
+            if (grown == NULL) {
+                perror("Couldn't allocate the NUMA nodes");
+                exit(EXIT_FAILURE);
+            }
+            *nodes = grown;
+        }
+        parseCpuList(list, &(*nodes)[numNodes]);
+        CPU_AND(&(*nodes)[numNodes], &(*nodes)[numNodes], &allowed);
+        if (CPU_COUNT(&(*nodes)[numNodes]) > 0) numNodes++; // memory only nodes have no CPU
+    }
+    if (dir != NULL) closedir(dir);
+
+    if (numNodes == 0) {
+        (*nodes)[0] = allowed;
+        numNodes = 1;
+    }
+    return numNodes;
+}
+
+/*
+ * Claims a chunk from the node's batch, claiming a new batch from the
+ * shared queue once it is empty. Returns -1 once every chunk is claimed.
+ */
+static int claimNodeChunk(struct hybridJob* job) {
+    struct nodeQueue* local = job->local;
+    int c = -1;
+
+    pthread_mutex_lock(&local->lock);
+    if (local->next == local->end) {
+        int batch = job->shared->nodeBatch;
+        int first = __atomic_fetch_add(&job->shared->next, batch, __ATOMIC_RELAXED);
+        local->next = first < job->shared->numChunks ? first : job->shared->numChunks;
+        local->end = first + batch < job->shared->numChunks ? first + batch : job->shared->numChunks;
+    }
+    if (local->next < local->end) c = local->next++;
+    pthread_mutex_unlock(&local->lock);
+    return c;
+}
+
+enum job_state resumeHybridJob(struct job* j) {
+    struct hybridJob* job = (struct hybridJob*)j;
+    int c = claimNodeChunk(job);
+    if (c < 0) return JOB_DONE;
+
+    const struct chunk* chunk = &job->chunks[c];
+    int both;
+    initWorkspace(&workerSpace, numPrisoners);
+    job->successes += simulateChunk(chunk, &workerSpace, streamKey(job->runSeed, chunk->maxTrials), &both);
+    job->bothSucceeded += both;
+    job->chunksDone++;
+    return JOB_YIELD;
+}
+
+/*
+ * Runs the threads of node "node" until the shared queue is empty, then
+ * writes their summed results to the node's slot of the shared region.
+ */
+static void runNode(struct hybridQueue* shared, int node, const cpu_set_t* cpus,
+                    int numThreads, const struct chunk* chunks, uint64_t runSeed) {
+    // every thread and buffer of the process stays on the node's CPUs
+    sched_setaffinity(0, sizeof(*cpus), cpus);
+
+    executor e;
+    struct hybridJob jobs[numThreads];
+    struct nodeQueue local = {PTHREAD_MUTEX_INITIALIZER, 0, 0};
+
+    executor_init(&e, numThreads, &traceHooks);
+    for (int i=0; i<numThreads; i++) {
+        jobs[i] = (struct hybridJob){{resumeHybridJob, NULL}, shared, &local, chunks, runSeed, 0, 0, 0};
+        executor_submit(&e, &jobs[i].base);
+    }
+    executor_wait(&e);
+    executor_shutdown(&e);
+
+    struct nodeResult result = {0};
+    for (int i=0; i<numThreads; i++) {
+        result.successes += jobs[i].successes;
+        result.bothSucceeded += jobs[i].bothSucceeded;
+        result.chunks += jobs[i].chunksDone;
+    }
+    shared->nodes[node] = result;
+}
+
+void simulateAndStatsHybrid(int n, int threadsPerNode) {
+    uint64_t runSeed = readSeed();
+    double start = now();
+    cpu_set_t* nodes;
+    int numNodes = numaNodes(&nodes);
+
+    int threads[numNodes], firstThread[numNodes], numThreads = 0, maxThreads = 0;
+    for (int i=0; i<numNodes; i++) {
+        threads[i] = threadsPerNode > 0 ? threadsPerNode : CPU_COUNT(&nodes[i]);
+        firstThread[i] = numThreads;
+        numThreads += threads[i];
+        if (threads[i] > maxThreads) maxThreads = threads[i];
+    }
+
+    int numChunks = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    struct chunk* chunks = malloc(sizeof(struct chunk)*numChunks);
+    if (chunks == NULL) {
+        perror("Couldn't allocate chunks");
+        exit(EXIT_FAILURE);
+    }
+    for (int i=0; i<numChunks; i++) {
+        long first = (long)i*CHUNK_SIZE;
+        chunks[i] = (struct chunk){trialsPerPrisoner, first,
+                                   n - first < CHUNK_SIZE ? n - first : CHUNK_SIZE, 0, defaultPrng, 0};
+    }
+
+    // only the claim counter and the nodes' results are shared, the
+    // children get their copy of the chunks when forked
+    size_t sharedSize = sizeof(struct hybridQueue) + sizeof(struct nodeResult)*numNodes;
+    struct hybridQueue* shared = mmap(NULL, sharedSize,
+                                      PROT_WRITE|PROT_READ, MAP_ANON|MAP_SHARED, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap failed");
+        exit(EXIT_FAILURE);
+    }
+    shared->next = 0;
+    shared->numChunks = numChunks;
+    shared->nodeBatch = NODE_BATCH_PER_THREAD*maxThreads;
+
+    startTrace(numThreads, "Thread");
+    for (int i=0; i<numNodes; i++) {
+        printf("Node %d, threads: %d, CPUs: %d\n", i, threads[i], CPU_COUNT(&nodes[i]));
+        fflush(stdout); // or the child prints it again
+        int pid = fork();
+        if (pid == 0) {
+            traceWorkerOffset = firstThread[i];
+            runNode(shared, i, &nodes[i], threads[i], chunks, runSeed);
+            exit(EXIT_SUCCESS);
+        }
+        else if (pid < 0) {
+            perror("fork failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    traceEvent(TRACE_STALL_BEGIN, 0);
+    while (wait(NULL) > 0);
+    traceEvent(TRACE_STALL_END, 0);
+
+    long sum = 0, both = 0;
+    int chunksDone = 0;
+    for (int i=0; i<numNodes; i++) {
+        sum += shared->nodes[i].successes;
+        both += shared->nodes[i].bothSucceeded;
+        chunksDone += shared->nodes[i].chunks;
+        printf("Node %d, chunks simulated: %d\n", i, shared->nodes[i].chunks);
+    }
+    munmap(shared, sharedSize);
+    free(chunks);
+    free(nodes);
+    if (chunksDone != numChunks) {
+        fprintf(stderr, "Only %d of %d chunks were simulated\n", chunksDone, numChunks);
+        exit(EXIT_FAILURE);
+    }
+    reportRun(sum, both, n, runSeed, now() - start, NULL, "All nodes");
+}
+
+/*
+ * Prints the result of a daemon job in a single line, so lines of jobs
+ * finishing on different threads are not interleaved, then frees the job.
+ */
+static void printDaemonJob(struct simJob* job) {
+    double mean = job->successes / (job->numSimulations + 0.0);
+    double w = 1.96*sqrt(mean*(1 - mean)/(job->numSimulations - 1));
+    printf("job %d: n=%d k=%d simulations=%ld estimate=%f 95%% CI: {%f, %f}\n",
+           job->id, job->numPrisoners, job->maxTrials, job->numSimulations,
+           mean, mean - w, mean + w);
+    fflush(stdout);
+    saveResult(job->numPrisoners, job->maxTrials, defaultPrng, job->seed,
+               job->numSimulations, job->successes, now() - job->started, NULL);
+    free(job);
+}
+
+void runDaemon(long defaultNumSimulations, int numThreads) {
+    executor e;
+    uint64_t runSeed = readSeed();
+    char* line = NULL;
+    size_t lineSize = 0;
+    int numJobs = 0;
+
+    startTrace(numThreads, "Thread");
+    executor_init(&e, numThreads, &traceHooks);
+    while (getline(&line, &lineSize, stdin) != -1) {
+        long n = defaultNumSimulations;
+        int prisoners = numPrisoners, boxes = trialsPerPrisoner;
+        int fields = sscanf(line, "%ld %d %d", &n, &prisoners, &boxes);
+        if (fields == 2) boxes = prisoners / 2;
+        if (fields == 0 || n < 2 || prisoners < 1 || boxes < 1 || boxes > prisoners) {
+            fprintf(stderr, "Ignoring invalid job: %s", line);
+            continue;
+        }
+
+        struct simJob* job = malloc(sizeof(struct simJob));
+        if (job == NULL) {
+            perror("Couldn't allocate job");
+            exit(EXIT_FAILURE);
+        }
+        initSimJob(job, prisoners, boxes, 0, n, streamKey(runSeed, numJobs));
+        job->id = ++numJobs;
+        job->started = now();
+        job->onDone = printDaemonJob;
+        executor_submit(&e, &job->base);
+    }
+    free(line);
+
+    executor_wait(&e);
+    executor_shutdown(&e);
+}
+
+void startTrace(int numWorkers, const char* workerName) {
+    if (tracePath == NULL) return;
+    if (trace_open(&tracing, numWorkers + 1) != 0) {
+        perror("Couldn't map trace buffers");
+        tracePath = NULL;
+        return;
+    }
+
+    char name[32];
+    for (int i=0; i<numWorkers; i++) {
+        snprintf(name, sizeof(name), "%s %d", workerName, i + 1);
+        trace_name(&tracing, i, name);
+    }
+    trace_name(&tracing, numWorkers, "Main");
+    traceWorker = numWorkers;
+}
+
+void traceEvent(enum trace_type type, uint64_t arg) {
+    if (tracing.buffers != NULL && traceWorker >= 0) {
+        trace_record(&tracing, traceWorker, type, arg);
+    }
+}
+
+static void traceStart(int worker) {
+    traceWorker = traceWorkerOffset + worker;
+}
+
+static void traceStall(int worker, int begin) {
+    if (tracing.buffers != NULL) {
+        trace_record(&tracing, traceWorkerOffset + worker,
+                     begin ? TRACE_STALL_BEGIN : TRACE_STALL_END, 0);
+    }
+}
+
+const struct executor_hooks traceHooks = {traceStart, traceStall};
+
+double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+/*
+ * Opens the results store on first use, returns 0 if there is none.
+ * Called with resultsLock held.
+ */
+static int openResults(void) {
+    if (!resultsOpen && storePath != NULL) {
+        if (store_open(&results, storePath) == 0) {
+            resultsOpen = 1;
+        }
+        else {
+            perror("Couldn't open results store");
+            storePath = NULL; // do not try again for every result
+        }
+    }
+    return resultsOpen;
+}
+
+void saveResult(int numPrisoners, int maxTrials, enum prng_t prng, uint64_t seed, long simulations,
+                long successes, double seconds, const struct cycleHistograms* hist) {
+    uint64_t bins[2*HISTOGRAM_BINS];
+    size_t numBins = 0;
+    if (hist != NULL) {
+        numBins = histogram_serialize(&hist->longest, HISTOGRAM_LONGEST, bins, 2*HISTOGRAM_BINS);
+        numBins += histogram_serialize(&hist->cycles, HISTOGRAM_CYCLES, bins + numBins,
+                                       2*HISTOGRAM_BINS - numBins);
+    }
+
+    struct store_record r = {
+        .key = {numPrisoners, maxTrials, method, prng},
+        .seed = seed,
+        .simulations = simulations,
+        .successes = successes,
+        .seconds = seconds,
+        .time = time(NULL),
+        .numBins = numBins,
+    };
+    snprintf(r.build, sizeof(r.build), "%s", BUILD_ID);
+
+    pthread_mutex_lock(&resultsLock);
+    if (openResults() && store_append(&results, &r, bins) != 0) {
+        perror("Couldn't store result");
+    }
+    pthread_mutex_unlock(&resultsLock);
+}
+
+void storedResults(int numPrisoners, int maxTrials, long* simulations, long* successes) {
+    struct store_key key = {numPrisoners, maxTrials, method, defaultPrng};
+    *simulations = *successes = 0;
+
+    pthread_mutex_lock(&resultsLock);
+    if (openResults()) {
+        struct store_index_entry e;
+        if (store_lookup(&results, &key, &e) > 0) {
+            *simulations = e.simulations;
+            *successes = e.successes;
+        }
+    }
+    pthread_mutex_unlock(&resultsLock);
+}
+
+int storedSeed(uint64_t seed, int kMin, int kMax) {
+    struct store_key* keys = malloc(sizeof(struct store_key)*(kMax - kMin + 1));
+    if (keys == NULL) {
+        perror("Couldn't allocate keys");
+        exit(EXIT_FAILURE);
+    }
+    for (int k=kMin; k<=kMax; k++) {
+        keys[k - kMin] = (struct store_key){numPrisoners, k, method, defaultPrng};
+    }
+
+    pthread_mutex_lock(&resultsLock);
+    int found = openResults() ? store_seeded(&results, keys, kMax - kMin + 1, seed) : 0;
+    pthread_mutex_unlock(&resultsLock);
+    free(keys);
+    if (found < 0) perror("Couldn't read results store");
+    return found > 0;
+}
+
+void reportRun(long sum, long bothSucceeded, long n, uint64_t seed, double seconds,
+               const struct cycleHistograms* hist, char* caller) {
+    long previousSimulations, previousSuccesses;
+
+    printStats(sum, n, caller);
+    printf("Seed: %llu\n", (unsigned long long)seed);
+    if (antithetic) printAntitheticStats(sum, bothSucceeded, n);
+    if (hist != NULL) printCycleHistograms(hist);
+    if (resumeResults) {
+        storedResults(numPrisoners, trialsPerPrisoner, &previousSimulations, &previousSuccesses);
+        if (previousSimulations > 0) {
+            printStats(sum + previousSuccesses, n + previousSimulations,
+                       "this run and the stored runs");
+        }
+    }
+    saveResult(numPrisoners, trialsPerPrisoner, defaultPrng, seed, n, sum, seconds, hist);
+}
+
+void printCycleHistograms(const struct cycleHistograms* hist) {
+    const histogram* h[] = {&hist->longest, &hist->cycles};
+    const char* names[] = {"Longest cycle", "Number of cycles"};
+
+    printf("\nCycles of the %lu simulations:\n", (unsigned long)hist->longest.total);
+    printf("%17s %10s %8s %8s %8s %8s %8s\n", "", "Mean", "1%", "Median", "90%", "99%", "Max");
+    for (int i=0; i<2; i++) {
+        printf("%17s %10.3f %8u %8u %8u %8u %8u\n", names[i], histogram_mean(h[i]),
+               histogram_quantile(h[i], 0.01), histogram_quantile(h[i], 0.5),
+               histogram_quantile(h[i], 0.9), histogram_quantile(h[i], 0.99),
+               histogram_quantile(h[i], 1));
+    }
+}
+
+void printAntitheticStats(long sum, long bothSucceeded, long n) {
+    long pairs = n / 2;
+    if (pairs < 2) return;
+
+    // a pair's mean is (a + b)/2, the sum of the squares of the pair means
+    // is sum((a + b)^2)/4 = (sum(a) + sum(b) + 2*sum(ab))/4
+    double mean = sum / (n + 0.0);
+    double squares = (sum + 2.0*bothSucceeded) / 4;
+    double pairVar = (squares - pairs*mean*mean) / (pairs - 1);
+    double var = (sum*(1 - mean))/(n-1);
+    double both = bothSucceeded / (pairs + 0.0);
+
+    printf("\nStatistics of the %ld antithetic pairs:\n", pairs);
+    printf("95%% CI: {%f, %f}\n",
+           mean - 1.96*sqrt(pairVar/pairs),
+           mean + 1.96*sqrt(pairVar/pairs));
+    printf("Correlation of the trials of a pair = %f\n",
+           mean > 0 && mean < 1 ? (both - mean*mean)/(mean*(1 - mean)) : 0);
+    if (pairVar > 0) {
+        // variance of the estimate from pairs, over that of n independent trials
+        printf("Variance reduction = %f (%s)\n", (var/n) / (pairVar/pairs),
+               (var/n) > (pairVar/pairs) ? "antithetic pairs pay" : "antithetic pairs do not pay");
+    }
+}
+
+void queryResults(int kMin, int kMax) {
+    uint32_t count;
+
+    pthread_mutex_lock(&resultsLock);
+    if (!openResults()) {
+        pthread_mutex_unlock(&resultsLock);
+        return;
+    }
+    struct store_index_entry* entries = store_entries(&results, &count);
+    if (entries == NULL) {
+        perror("Couldn't read results store");
+        pthread_mutex_unlock(&resultsLock);
+        return;
+    }
+
+    // runs with -H stored the cycles of their trials, which do not depend on
+    // the configuration but on the number of prisoners
+    // the configurations printed, whose stored cycles are read in one go
+    struct cycleHistograms* hist = calloc(1, sizeof(struct cycleHistograms));
+    struct store_key* keys = malloc(sizeof(struct store_key)*(count + 1));
+    uint32_t numKeys = 0;
+    if (hist == NULL || keys == NULL) {
+        perror("Couldn't allocate histograms");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%6s %6s %13s %9s %6s %14s %12s %25s\n", "n", "Boxes", "Method", "PRNG",
+           "Runs", "Simulations", "Estimate", "95% CI");
+    for (int k=kMin; k<=kMax; k++) {
+        long simulations = 0, successes = 0;
+        for (uint32_t i=0; i<count; i++) {
+            const struct store_index_entry* e = &entries[i];
+            if (e->key.numPrisoners != numPrisoners || e->key.maxTrials != k) {
+                continue;
+            }
+            double mean = e->successes / (e->simulations + 0.0);
+            double w = 1.96*sqrt(mean*(1 - mean)/e->simulations);
+            printf("%6d %6d %13s %9s %6u %14lu %12f     {%f, %f}\n", numPrisoners, k,
+                   e->key.method < METHOD_COUNT ? methodNames[e->key.method] : "?",
+                   e->key.prng < PRNG_COUNT ? prngNames[e->key.prng] : "?",
+                   e->numRecords, (unsigned long)e->simulations,
+                   mean, mean - w, mean + w);
+            simulations += e->simulations;
+            successes += e->successes;
+            keys[numKeys++] = e->key;
+        }
+        if (simulations > 0) { // every kernel and PRNG estimates the same probability
+            double mean = successes / (simulations + 0.0);
+            double w = 1.96*sqrt(mean*(1 - mean)/simulations);
+            printf("%6d %6d %13s %9s %6s %14ld %12f     {%f, %f}\n", numPrisoners, k,
+                   "all", "all", "", simulations, mean, mean - w, mean + w);
+        }
+    }
+
+    uint64_t* bins;
+    uint32_t numBins;
+    if (numKeys > 0 && store_bins(&results, keys, numKeys, &bins, &numBins) != 0) {
+        perror("Couldn't read stored histograms");
+    }
+    else if (numKeys > 0) {
+        histogram_deserialize(&hist->longest, HISTOGRAM_LONGEST, bins, numBins);
+        histogram_deserialize(&hist->cycles, HISTOGRAM_CYCLES, bins, numBins);
+        free(bins);
+    }
+    if (hist->longest.total > 0) {
+        // stored bins only bound the largest values, which are at most n
+        if (hist->longest.max > (uint32_t)numPrisoners) hist->longest.max = numPrisoners;
+        if (hist->cycles.max > (uint32_t)numPrisoners) hist->cycles.max = numPrisoners;
+        printCycleHistograms(hist);
+    }
+    free(keys);
+    free(hist);
+    free(entries);
+    pthread_mutex_unlock(&resultsLock);
+}
+
+static int compareDescending(const void* a, const void* b) {
+    return *(const int*)b - *(const int*)a;
+}
+
+void replayTrial(uint64_t seed, long index, char mode) {
+    int size = numPrisoners;
+    uint64_t key = streamKey(seed, trialsPerPrisoner);
+    long blockStart = index / TRIAL_BLOCK * TRIAL_BLOCK;
+    // c mode runs hand consecutive chunks to every PRNG in turn
+    enum prng_t trialPrng = mode == 'c' ? (index / CHUNK_SIZE) % PRNG_COUNT : defaultPrng;
+
+    // replay the trials before it in its block, with the run's kernel, so
+    // the generator is where the run left it at the trial
+    struct chunk before = {trialsPerPrisoner, blockStart, index - blockStart, 0, trialPrng, 0};
+    initWorkspace(&workerSpace, size);
+    double start = now();
+    prng = trialPrng;
+    seedStream(streamKey(key, index / TRIAL_BLOCK));
+    if (index > blockStart) simulateChunk(&before, &workerSpace, key, NULL);
+
+    // draw every index of the trial's shuffle, a kernel stopping early
+    // would have drawn a prefix of them
+    int* trialDraws = malloc(sizeof(int)*size);
+    int* boxes = malloc(sizeof(int)*size);
+    if (trialDraws == NULL || boxes == NULL) {
+        perror("Couldn't allocate the trial");
+        exit(EXIT_FAILURE);
+    }
+    for (int i=size-1; i>0; i--) {
+        if (antithetic && index % 2 == 1) { // reflection of its pair's draws
+            trialDraws[i] = i - workerSpace.draws[i];
+        }
+        else {
+            trialDraws[i] = drawInt(i);
+        }
+    }
+    double regenerated = now() - start;
+
+    draws = trialDraws;
+    drawMode = DRAW_REPLAY;
+    for (int i=0; i<size; i++) {
+        boxes[i] = i;
+    }
+    randomizeArray(boxes, size);
+
+    // the verdict of every kernel, each replaying the same draws
+    enum method_t runMethod = method;
+    int verdicts[METHOD_COUNT];
+    for (int m=0; m<METHOD_COUNT; m++) {
+        struct workspace w = {0};
+        // every prisoner follows up to maxTrials boxes in the naive kernel
+        if (m == METHOD_NAIVE && (long)size*trialsPerPrisoner > REPLAY_MAX_NAIVE_STEPS) {
+            verdicts[m] = -1;
+            continue;
+        }
+        method = m;
+        initWorkspace(&w, size);
+        verdicts[m] = runKernel(&w, trialsPerPrisoner);
+        arena_free(&w.a);
+    }
+    method = runMethod;
+    drawMode = DRAW_FRESH;
+
+    // cycle lengths, by walking the boxes
+    int* lengths = trialDraws; // the draws are not needed anymore
+    int numCycles = 0;
+    char* visited = calloc(size, 1);
+    if (visited == NULL) {
+        perror("Couldn't allocate the trial");
+        exit(EXIT_FAILURE);
+    }
+    for (int i=0; i<size; i++) {
+        if (visited[i]) continue;
+        int length = 0;
+        for (int j=i; !visited[j]; j=boxes[j]) {
+            visited[j] = 1;
+            length++;
+        }
+        lengths[numCycles++] = length;
+    }
+    free(visited);
+    qsort(lengths, numCycles, sizeof(int), compareDescending);
+
+    int failing = 0;
+    for (int c=0; c<numCycles && lengths[c] > trialsPerPrisoner; c++) {
+        failing += lengths[c];
+    }
+    enum found_t expected = lengths[0] <= trialsPerPrisoner ? FOUND : NOT_FOUND;
+
+    printf("Trial %ld of the run with seed %llu (block %ld, %s, %s%s)\n", index,
+           (unsigned long long)seed, index / TRIAL_BLOCK, prngNames[trialPrng],
+           methodNames[method], antithetic ? ", antithetic" : "");
+    printf("Regenerated in %.1f us\n", regenerated*1e6);
+    if (size <= REPLAY_MAX_BOXES_PRINTED) {
+        printf("Boxes:");
+        for (int i=0; i<size; i++) {
+            printf(" %d", boxes[i]);
+        }
+        printf("\n");
+    }
+    printf("%d cycles, longest %d, prisoners not finding their tag %d:", numCycles, lengths[0], failing);
+    for (int c=0; c<numCycles; c++) {
+        printf(" %d", lengths[c]);
+    }
+    printf("\n");
+    printf("Expected verdict with %d boxes opened: %s\n", trialsPerPrisoner,
+           expected == FOUND ? "found" : "not found");
+    for (int m=0; m<METHOD_COUNT; m++) {
+        if (verdicts[m] < 0) {
+            printf("%13s: skipped, too slow with this many prisoners\n", methodNames[m]);
+            continue;
+        }
+        printf("%13s: %s%s\n", methodNames[m], verdicts[m] == FOUND ? "found" : "not found",
+               verdicts[m] != (int)expected ? " (disagrees)" : "");
+    }
+    free(trialDraws);
+    free(boxes);
+}
+
+void publishProgress(const struct chunkQueue* q, int keep) {
+    if (live.segment == NULL) return;
+
+    struct publish_snapshot s = published;
+    for (int i=0; i<q->numChunks; i++) {
+        const struct queuedChunk* qc = &q->chunks[i];
+        if (__atomic_load_n(&qc->state, __ATOMIC_ACQUIRE) != CHUNK_DONE) continue;
+
+        int bin = qc->c.successes * PUBLISH_BINS / qc->c.numSimulations;
+        s.bins[bin < PUBLISH_BINS ? bin : PUBLISH_BINS - 1]++;
+        s.simulations += qc->c.numSimulations;
+        s.successes += qc->c.successes;
+    }
+    s.seconds = now() - publishStart;
+    s.rate = s.seconds > 0 ? s.simulations / s.seconds : 0;
+    publish_write(&live, &s);
+    if (keep) published = s;
+}
+
+void subscribeResults(const char* name) {
+    subscriber s;
+    if (subscribe_open(&s, name) != 0) {
+        perror("Couldn't open the published snapshot");
+        exit(EXIT_FAILURE);
+    }
+
+    struct publish_snapshot snapshot;
+    double lastSeconds = -1, lastChange = now();
+    printf("%10s %14s %12s %25s %14s\n", "Seconds", "Simulations", "Estimate", "95% CI", "Per second");
+    do {
+        subscribe_read(&s, &snapshot);
+        // a run publishes every PUBLISH_INTERVAL_NS until it is done, one
+        // that stopped publishing died without saying so
+        if (snapshot.seconds != lastSeconds) {
+            lastSeconds = snapshot.seconds;
+            lastChange = now();
+        }
+        else if (!snapshot.done && now() - lastChange > SUBSCRIBE_STALE_SECONDS) {
+            fprintf(stderr, "The run publishing %s stopped publishing %g s ago\n",
+                    name, now() - lastChange);
+            subscribe_close(&s);
+            exit(EXIT_FAILURE);
+        }
+        double mean = snapshot.simulations ? snapshot.successes / (snapshot.simulations + 0.0) : 0;
+        double w = snapshot.simulations ? 1.96*sqrt(mean*(1 - mean)/snapshot.simulations) : 1;
+        printf("%10.1f %14lu %12f     {%f, %f} %14.0f\n", snapshot.seconds,
+               (unsigned long)snapshot.simulations, mean, mean - w, mean + w, snapshot.rate);
+        fflush(stdout);
+        if (!snapshot.done) nanosleep(&(struct timespec){0, SUBSCRIBE_INTERVAL_NS}, NULL);
+    } while (!snapshot.done);
+
+    printf("Chunks by estimate (n=%d, k=%d):\n", snapshot.numPrisoners, snapshot.maxTrials);
+    for (uint32_t i=0; i<snapshot.numBins && i<PUBLISH_BINS; i++) {
+        if (snapshot.bins[i] > 0) {
+            printf("  [%.2f, %.2f) %lu\n", i / (double)snapshot.numBins,
+                   (i + 1) / (double)snapshot.numBins, (unsigned long)snapshot.bins[i]);
+        }
+    }
+    subscribe_close(&s);
+}
+
+void buildTables(int maxN) {
+    double start = now();
+    if (tables_build(tablesPath, maxN) != 0) {
+        perror("Couldn't build exact cycle tables");
+        exit(EXIT_FAILURE);
+    }
+    printf("Exact cycle tables for up to %d boxes written to %s in %f s\n",
+           maxN, tablesPath, now() - start);
+}
+
+void printExact(int kMin, int kMax) {
+    tables t;
+    if (tables_open(&t, tablesPath) != 0) {
+        perror("Couldn't open exact cycle tables, build them with --build-tables");
+        exit(EXIT_FAILURE);
+    }
+    if (numPrisoners > t.header->maxN) {
+        fprintf(stderr, "Exact cycle tables only go up to %d boxes\n", t.header->maxN);
+        tables_close(&t);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%6s %6s %22s %22s\n", "n", "Boxes", "P(longest cycle <= k)", "P(longest cycle = k)");
+    for (int k=kMin; k<=kMax; k++) {
+        double cdf = tables_longest_cdf(&t, numPrisoners, k);
+        // a cycle longer than n/2 is unique, and one of length k has
+        // probability 1/k. Below, the difference does not cancel
+        double p = 2*k > numPrisoners ? 1.0/k : cdf - tables_longest_cdf(&t, numPrisoners, k - 1);
+        printf("%6d %6d %22.15g %22.15g\n", numPrisoners, k, cdf, p > 0 ? p : 0);
+    }
+
+    // the number of cycles concentrates around log n, skip the negligible tail
+    printf("\n%6s %6s %22s\n", "n", "Cycles", "P(cycles = c)");
+    for (int c=1; c<=numPrisoners; c++) {
+        double p = tables_cycle_count(&t, numPrisoners, c);
+        if (p >= EXACT_MIN_PROBABILITY) printf("%6d %6d %22.15g\n", numPrisoners, c, p);
+    }
+    tables_close(&t);
+}
+
+double exactProbability(int numPrisoners, int maxTrials) {
+    if (2*maxTrials >= numPrisoners) {
+        // at most one cycle can be longer than maxTrials, and there are
+        // n!/l permutations with a cycle of length l > n/2, so
+        // P = 1 - (H(n) - H(maxTrials))
+        long double sum = 0;
+        for (int l=numPrisoners; l>maxTrials; l--) {
+            sum += 1.0L/l;
+        }
+        return 1 - sum;
+    }
+    if (numPrisoners > EXACT_MAX_PRISONERS) return NAN;
+
+    // probability that no cycle of a random permutation of m elements is
+    // longer than maxTrials, summed without subtractions
+    double* p = malloc(sizeof(double)*(numPrisoners + 1));
+    double* suffix = malloc(sizeof(double)*maxTrials);
+    if (p == NULL || suffix == NULL) {
+        free(p);
+        free(suffix);
+        return NAN;
+    }
+    tables_longest_sequence(p, suffix, numPrisoners, maxTrials);
+    double result = p[numPrisoners];
+    free(p);
+    free(suffix);
+    return result;
+}
+
+/*
+ * Regularized upper incomplete gamma function Q(a, x), by its series for
+ * x < a + 1 and its continued fraction otherwise (Numerical Recipes 6.2).
+ */
+static double upperGamma(double a, double x) {
+    if (x <= 0) return 1;
+    double logPrefix = a*log(x) - x - lgamma(a);
+
+    if (x < a + 1) {
+        double term = 1/a, sum = term;
+        for (int n=1; n<1000 && fabs(term) > fabs(sum)*1e-15; n++) {
+            term *= x/(a + n);
+            sum += term;
+        }
+        return 1 - sum*exp(logPrefix);
+    }
+
+    double b = x + 1 - a, c = 1/1e-300, d = 1/b, h = d;
+    for (int i=1; i<1000; i++) {
+        double an = -i*(i - a);
+        b += 2;
+        d = an*d + b;
+        if (fabs(d) < 1e-300) d = 1e-300;
+        c = b + an/c;
+        if (fabs(c) < 1e-300) c = 1e-300;
+        d = 1/d;
+        double delta = d*c;
+        h *= delta;
+        if (fabs(delta - 1) < 1e-15) break;
+    }
+    return exp(logPrefix)*h;
+}
+
+double chiSquarePValue(double x, int degreesOfFreedom) {
+    return upperGamma(degreesOfFreedom/2.0, x/2.0);
+}
+
+/*
+ * Two sided p-value of an estimate of "exact" from n Bernoulli trials.
+ */
+static double exactPValue(long successes, long n, double exact) {
+    if (isnan(exact) || exact <= 0 || exact >= 1) return NAN;
+    double z = (successes - n*exact)/sqrt(n*exact*(1 - exact));
+    return erfc(fabs(z)/sqrt(2));
+}
+
+void consensusWithProcesses(int n, int numProcesses) {
+    uint64_t runSeed = readSeed();
+    double start = now();
+    int numChunks = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    struct chunk* chunks = malloc(sizeof(struct chunk)*numChunks);
+    if (chunks == NULL) {
+        perror("Couldn't allocate chunks");
+        exit(EXIT_FAILURE);
+    }
+
+    // consecutive chunks of the run go to different PRNGs, so every PRNG is
+    // used during the whole run and sees a similar share of it
+    for (int i=0; i<numChunks; i++) {
+        long first = (long)i*CHUNK_SIZE;
+        chunks[i] = (struct chunk){trialsPerPrisoner, first,
+                                   n - first < CHUNK_SIZE ? n - first : CHUNK_SIZE, 0,
+                                   i % PRNG_COUNT, 0};
+    }
+    startTrace(numProcesses, "Process");
+    simulateChunksWithProcesses(chunks, numChunks, numProcesses, runSeed, NULL, 0);
+    double seconds = now() - start;
+
+    long simulations[PRNG_COUNT] = {0}, successes[PRNG_COUNT] = {0};
+    long totalSuccesses = 0;
+    for (int i=0; i<numChunks; i++) {
+        simulations[chunks[i].prng] += chunks[i].numSimulations;
+        successes[chunks[i].prng] += chunks[i].successes;
+        totalSuccesses += chunks[i].successes;
+    }
+    free(chunks);
+
+    double exact = exactProbability(numPrisoners, trialsPerPrisoner);
+    double pooled = totalSuccesses / (n + 0.0);
+    printf("\nStatistics of every PRNG (exact probability %.8f):\n", exact);
+    printf("%9s %12s %12s %25s %14s\n", "PRNG", "Simulations", "Estimate", "95% CI", "p-value exact");
+
+    // chi-square test that every PRNG estimates the same probability
+    double chiSquare = 0;
+    int numUsed = 0;
+    for (int g=0; g<PRNG_COUNT; g++) {
+        if (simulations[g] == 0) continue;
+        double mean = successes[g] / (simulations[g] + 0.0);
+        double w = 1.96*sqrt(mean*(1 - mean)/simulations[g]);
+        printf("%9s %12ld %12f     {%f, %f} %14.4g\n", prngNames[g], simulations[g],
+               mean, mean - w, mean + w, exactPValue(successes[g], simulations[g], exact));
+
+        double expected = simulations[g]*pooled;
+        if (expected > 0 && expected < simulations[g]) {
+            double d = successes[g] - expected;
+            chiSquare += d*d/expected + d*d/(simulations[g] - expected);
+        }
+        numUsed++;
+        // each PRNG's share is stored as a run of its own
+        saveResult(numPrisoners, trialsPerPrisoner, g, runSeed, simulations[g], successes[g], seconds, NULL);
+    }
+    double w = 1.96*sqrt(pooled*(1 - pooled)/n);
+    printf("%9s %12d %12f     {%f, %f} %14.4g\n", "pooled", n, pooled,
+           pooled - w, pooled + w, exactPValue(totalSuccesses, n, exact));
+    if (numUsed > 1) {
+        printf("Homogeneity of the PRNGs: chi-square = %f, %d degrees of freedom, p-value = %.4g\n",
+               chiSquare, numUsed - 1, chiSquarePValue(chiSquare, numUsed - 1));
+    }
+}
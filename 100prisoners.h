@@ -1,140 +1,791 @@
-#ifndef UNION
-#define UNION
-#include "union-find/union-find.h"
-#endif
-
-/*
- * Simulates the 100 prisoners problem "n" times using the
- * best strategy and prints the statistics.
- *
- * int n is the number of simulations to simulate the 100 prisoners problem
- *
- * char* caller is the name of the function calling simulateAndStats.
- * This is used incase of debugging, to print statistics of all threads
- * or processes
- *
- * The return value is the number of times the simulations succeeded,
- * or the number of times all prisoners found their tag number.
- */
-int simulateAndStats(int n, char* caller);
-
-/*
- * Simulates the 100 prisoners problem once using the
- * union find data structure and returns success or failure.
- * success = 1 and failure = 0
- */
-enum found_t {
-    NOT_FOUND = 0,
-    FOUND = 1,
-};
-enum found_t runSimulation(set_union* s);
-
-/*
- * Simulates the 100 prisoners problem once using a
- * naive approach and returns success or failure.
- * success in this function only occurs if all prisoners find their tag
- */
-enum found_t runNaiveSimulation(void);
-
-/*
- * Simulates each prisoner to look for his tag number
- *
- * int prisonerNum is the number of the prisoner looking for his tag number.
- * This prisoner is looking for the number prisonerNum.
- *
- * int boxes[] is the room of uniformly distributed boxes.
- * prisoner #prisonerNum is looking through 50 boxes in boxes[]
- *
- * if prisoner #prisonerNum finds his tag, lookForTag returns 1
- * if the prisoner does not find his tag within 50 trails,
- * lookForTag returns 0
- */
-int lookForTag(int prisonerNum, int boxes[]);
-
-/*
- * Prints the statistics of a simulation that ran "n" times.
- * The statistics include the estimated parameter, variance of the parameter,
- * and a 95% confidence interval.
- *
- * int sum is the number of successes that the simulation returned
- *
- * int n is the number of simulations performed
- *
- * char* caller is the name of the thread / process that called printStats
- */
-void printStats(int sum, int n, char* caller);
-
-/*
- * Performs a single simulation of the 100 prisoners problem
- * using the union find data structure.
- * set_union* s is a pointer to the set of paths created
- *              from the randomization of the set of boxes.
- *              If a set is larger than 50, that means that
- *              at least 1 prisoner would need to inspect more
- *              than 50 boxes.
- * int size is the number of boxes.
- */
-enum found_t single_simulation(set_union* s, int size);
-
-/*
- * Randomizes / shuffles the array using the Fisher-Yates (Knuth) shuffle
- * algorithm.
- * http://en.wikipedia.org/wiki/Fisher–Yates_shuffle
- *
- * Source of algorithm implementation:
- * D. E. Knuth, "Random Numbers", in The Art of Computer Programming, Volume 2:
- * Seminumerical Algorithms, 3rd ed. Boston, Massachusetts: Addison-Wesley Professional,
- * 1997, ch. 3, sec. 4.2, pp. 145
- *
- * int* array is the array to randomize / shuffle
- *
- * int size is the size of the array
- */
-void randomizeArray(int* array, int size);
-
-/*
- * Specifies the method / PRNG to return a random number
- *
- * int currentIndex is used to specify the range of the PRNG, in other words,
- * the PRNG will return a number in the range [0, currentIndex]
- */
-unsigned int randomInt(int currentIndex);
-
-/*
- * Seeds the random() function.
- * Using random() instead of rand() for better randomness.
- */
-void seed(void);
-
-/*
- * Simulates 100 prisoners problem "n" times using numProcesses processes.
- * very similar to simulateAndStatsWithThreads, except instead of spawning
- * new threads, new processes are spawned.
- *
- * int n is the total number of simulations to be performed
- *
- * int numProcesses is the number of processes to create and simulate the
- * 100 prisoners problem (n / numProcesses) times.
- *
- * eg. if n == 100, and numProcesses == 4, then each process performes 100/4 = 25 simulations
- */
-void simulateAndStatsWithProcesses(int n, int numProcesses);
-
-/*
- * The threads or processes take a parameter to call the
- * splitSimulation function.
- */
-struct simParam {
-    char* taskName; // name of caller, name could be either Thread or Process
-    int taskNum;    // the number or id of each thread or process, eg. Thread 1 / Process 3
-    int* successes; // shared array to store number of successes in their respective location.
-                    // their respective location is index of their number, their threadOrProcessNum
-    int numSimulations; // number of simulations for this thread or process to simulate.
-};
-
-/*
- * Specialized simulation function dedicated for threads or processes.
- */
-void* splitSimulation(struct simParam* p);
-
-void printUsage(void);
+#ifndef UNION
+#define UNION
+#include "union-find/union-find.h"
+#endif
+
+#include <stdint.h>
+
+#ifndef ARENA
+#define ARENA
+#include "arena/arena.h"
+#endif
+
+#ifndef PACKED
+#define PACKED
+#include "packed/packed.h"
+#endif
+
+#ifndef EXECUTOR
+#define EXECUTOR
+#include "executor/executor.h"
+#endif
+
+#ifndef TRACE
+#define TRACE
+#include "trace/trace.h"
+#endif
+
+#ifndef JOINT
+#define JOINT
+#include "joint/joint.h"
+#endif
+
+#ifndef TABLES
+#define TABLES
+#include "tables/tables.h"
+#endif
+
+#ifndef PUBLISH
+#define PUBLISH
+#include "publish/publish.h"
+#endif
+
+#ifndef HISTOGRAM
+#define HISTOGRAM
+#include "histogram/histogram.h"
+#endif
+
+/*
+ * Simulates the 100 prisoners problem "n" times using the
+ * best strategy and prints the statistics.
+ *
+ * int n is the number of simulations to simulate the 100 prisoners problem
+ *
+ * char* caller is the name of the function calling simulateAndStats.
+ * This is used incase of debugging, to print statistics of all threads
+ * or processes
+ *
+ * The return value is the number of times the simulations succeeded,
+ * or the number of times all prisoners found their tag number.
+ */
+int simulateAndStats(int n, char* caller);
+
+/*
+ * Simulates the 100 prisoners problem once using the
+ * union find data structure and returns success or failure.
+ * success = 1 and failure = 0
+ */
+enum found_t {
+    NOT_FOUND = 0,
+    FOUND = 1,
+};
+enum found_t runSimulation(set_union* s);
+
+/*
+ * Simulates the 100 prisoners problem once using a
+ * naive approach and returns success or failure.
+ * success in this function only occurs if all prisoners find their tag
+ *
+ * int boxes[] is a buffer for the room of boxes, one per prisoner
+ *
+ * int size is the number of prisoners
+ *
+ * int maxTrials is the number of boxes each prisoner may open
+ */
+enum found_t runNaiveSimulation(int boxes[], int size, int maxTrials);
+
+/*
+ * Kernels that can simulate a trial, selected with -m.
+ * union:        union find built while shuffling (single_simulation)
+ * naive:        every prisoner follows the boxes (runNaiveSimulation)
+ * packed:       the boxes are shuffled as a bit packed permutation and
+ *               every cycle is walked once (runPackedSimulation)
+ * packed-union: union find built while shuffling, stored as a single
+ *               bit packed array (single_simulation_packed)
+ * prefetch:     the cycles are walked by several cursors at once, each
+ *               prefetching its next box (runPrefetchSimulation)
+ * packed uses ceil(log2 n) + 1 bits per prisoner (boxes and visited
+ * bitset) instead of the naive kernel's 32, which saves little for large
+ * n: 21 bits at n = 10^6, 28 at n = 10^8. packed-union uses
+ * ceil(log2 (n+1)) + 1 bits instead of the union kernel's 64, about a
+ * third of the memory at n = 10^6 and under half at n = 10^8.
+ */
+enum method_t {
+    METHOD_UNION,
+    METHOD_NAIVE,
+    METHOD_PACKED,
+    METHOD_PACKED_UNION,
+    METHOD_PREFETCH,
+    METHOD_COUNT,
+};
+
+/*
+ * Simulates each prisoner to look for his tag number
+ *
+ * int prisonerNum is the number of the prisoner looking for his tag number.
+ * This prisoner is looking for the number prisonerNum.
+ *
+ * int boxes[] is the room of uniformly distributed boxes.
+ * prisoner #prisonerNum is looking through 50 boxes in boxes[]
+ *
+ * int maxTrials is the number of boxes the prisoner may open
+ *
+ * if prisoner #prisonerNum finds his tag, lookForTag returns 1
+ * if the prisoner does not find his tag within maxTrials trials,
+ * lookForTag returns 0
+ */
+int lookForTag(int prisonerNum, int boxes[], int maxTrials);
+
+/*
+ * Prints the statistics of a simulation that ran "n" times.
+ * The statistics include the estimated parameter, variance of the parameter,
+ * and a 95% confidence interval.
+ *
+ * int sum is the number of successes that the simulation returned
+ *
+ * int n is the number of simulations performed
+ *
+ * char* caller is the name of the thread / process that called printStats
+ */
+void printStats(long sum, long n, char* caller);
+
+/*
+ * Performs a single simulation of the 100 prisoners problem
+ * using the union find data structure.
+ * set_union* s is a pointer to the set of paths created
+ *              from the randomization of the set of boxes.
+ *              If a set is larger than 50, that means that
+ *              at least 1 prisoner would need to inspect more
+ *              than 50 boxes.
+ * int size is the number of boxes.
+ * int maxTrials is the number of boxes each prisoner may open.
+ */
+enum found_t single_simulation(set_union* s, int size, int maxTrials);
+
+/*
+ * Same as single_simulation, with the union find structure packed in a
+ * single array. Roots have their top bit set and hold the size of their
+ * set, other elements hold their parent.
+ *
+ * packed_array* forest must have packed_bits_for(size) + 1 bits per element.
+ */
+enum found_t single_simulation_packed(packed_array* forest, int size, int maxTrials);
+
+/*
+ * Randomizes / shuffles the array using the Fisher-Yates (Knuth) shuffle
+ * algorithm.
+ * http://en.wikipedia.org/wiki/Fisher–Yates_shuffle
+ *
+ * Source of algorithm implementation:
+ * D. E. Knuth, "Random Numbers", in The Art of Computer Programming, Volume 2:
+ * Seminumerical Algorithms, 3rd ed. Boston, Massachusetts: Addison-Wesley Professional,
+ * 1997, ch. 3, sec. 4.2, pp. 145
+ *
+ * int* array is the array to randomize / shuffle
+ *
+ * int size is the size of the array
+ */
+void randomizeArray(int* array, int size);
+
+/*
+ * Same as randomizeArray, for a bit packed array.
+ */
+void randomizePackedArray(packed_array* array);
+
+/*
+ * PRNGs that can be selected at run time with -g. The default one is
+ * selected at compile time with -DPRNG=0 (default) to 3.
+ */
+enum prng_t {
+    PRNG_RANDOM,   // random_r, same generator as random()
+    PRNG_MRG32K3A,
+    PRNG_DSFMT,
+    PRNG_LFIB4,
+    PRNG_COUNT,
+};
+
+/*
+ * Where randomInt takes its numbers from. With -A, the trials go in
+ * antithetic pairs: the first trial of a pair draws the number of every
+ * currentIndex up front and replays them, the second one replays their
+ * reflections currentIndex - number, another uniform permutation that is
+ * negatively correlated with the first one.
+ */
+enum draw_mode {
+    DRAW_FRESH,   // from the PRNG
+    DRAW_REPLAY,  // the numbers drawn for the pair
+    DRAW_REFLECT, // the reflections of the numbers drawn for the pair
+    DRAW_RECORD,  // from the PRNG, keeping the numbers drawn for the histograms
+};
+
+/*
+ * Specifies the method / PRNG to return a random number
+ *
+ * int currentIndex is used to specify the range of the PRNG, in other words,
+ * the PRNG will return a number in the range [0, currentIndex]
+ */
+unsigned int randomInt(int currentIndex);
+
+/*
+ * Seeds the random() function.
+ * Using random() instead of rand() for better randomness.
+ */
+void seed(void);
+
+/*
+ * Reads a 64 bit seed from /dev/urandom, or returns the one given with --seed.
+ */
+uint64_t readSeed(void);
+
+/*
+ * SplitMix64 generator, used to expand 64 bit keys into seeds for the PRNGs.
+ * uint64_t* state is advanced on every call.
+ */
+uint64_t splitmix64(uint64_t* state);
+
+/*
+ * Derives the key of sub stream number "index" of the stream "key".
+ */
+uint64_t streamKey(uint64_t key, uint64_t index);
+
+/*
+ * Seeds the PRNG the calling thread uses from a 64 bit key.
+ * The same key always gives the same sequence of random numbers.
+ */
+void seedStream(uint64_t key);
+
+/*
+ * Simulates 100 prisoners problem "n" times using numProcesses processes.
+ * The run is split in chunks that the processes claim from a shared queue,
+ * see simulateChunksWithProcesses.
+ *
+ * int n is the total number of simulations to be performed
+ *
+ * int numProcesses is the number of processes to create and simulate the
+ * 100 prisoners problem.
+ */
+void simulateAndStatsWithProcesses(int n, int numProcesses);
+
+/*
+ * A chunk of simulations handed to a worker. Chunks are made of blocks of
+ * TRIAL_BLOCK trials, block b of a chunk being seeded from
+ * streamKey(key, b), so the outcome of a chunk only depends on the key
+ * and its firstTrial, not on the worker simulating it.
+ */
+struct chunk {
+    int maxTrials;      // number of boxes each prisoner may open
+    long firstTrial;    // index of the first trial of the chunk in its stream
+    int numSimulations; // number of simulations in the chunk
+    int successes;      // filled in by the worker that simulated the chunk
+    int prng;           // PRNG the chunk is simulated with, enum prng_t
+    int bothSucceeded;  // antithetic pairs of which both trials succeeded, with -A
+};
+
+/*
+ * A chunk in a chunkQueue, with the state the scheduler tracks.
+ */
+enum chunk_state {
+    CHUNK_PENDING,
+    CHUNK_RUNNING,
+    CHUNK_SAVING,  // a copy finished first and is writing its results
+    CHUNK_DONE,    // the results of the chunk can be read
+};
+
+struct queuedChunk {
+    struct chunk c;
+    int state;      // enum chunk_state
+    int copies;     // number of workers that started the chunk, at most 2
+    double claimed; // time the first copy started, see now()
+};
+
+/*
+ * Chunks shared between processes, workers claim chunks by
+ * incrementing next. Once no chunk is left to claim, idle workers start a
+ * second copy of chunks that have been running for more than
+ * STRAGGLER_FACTOR times the average chunk time. Both copies simulate the
+ * same trials of the same stream, the first one to finish is kept.
+ *
+ * A sweep adds a round of chunks at the end of the queue once the previous
+ * round is done, so the chunks of earlier rounds are never reused and a
+ * copy still running one of them cannot change the new ones.
+ */
+struct chunkQueue {
+    int next;
+    int numChunks;
+    int first;           // first chunk of the latest round
+    int done;            // number of chunks done
+    uint64_t doneNanos;  // time spent on the chunks done, in ns
+    int speculated;      // number of second copies started
+    int speculativeWins; // number of second copies that finished first
+    struct queuedChunk chunks[];
+};
+
+/*
+ * Results of the threads of one node in h mode, reduced in the node before
+ * being written to the region shared with the parent. Padded to a cache
+ * line, and aligned on one in struct hybridQueue, so nodes never write to
+ * the same line.
+ */
+struct nodeResult {
+    long successes;
+    long bothSucceeded;
+    int chunks; // number of chunks simulated by the node
+    char padding[64 - 2*sizeof(long) - sizeof(int)];
+};
+
+/*
+ * Region shared by the processes of h mode. Nodes claim batches of
+ * nodeBatch chunks at a time by incrementing next.
+ */
+struct hybridQueue {
+    int next;
+    int numChunks;
+    int nodeBatch;
+    _Alignas(64) struct nodeResult nodes[]; // the region is page aligned
+};
+
+/*
+ * Chunks claimed by a node and not yet claimed by one of its threads.
+ */
+struct nodeQueue {
+    pthread_mutex_t lock;
+    int next;
+    int end;
+};
+
+/*
+ * A thread of a node in h mode, as a job of the node's executor yielding
+ * after every chunk, until the node cannot claim any more chunks.
+ */
+struct hybridJob {
+    struct job base; // must be first, the executor only sees this member
+    struct hybridQueue* shared;
+    struct nodeQueue* local;
+    const struct chunk* chunks;
+    uint64_t runSeed;
+    long successes;
+    long bothSucceeded;
+    int chunksDone;
+};
+
+/*
+ * Simulates the next chunk claimed by the job's node, called by the executor.
+ */
+enum job_state resumeHybridJob(struct job* j);
+
+/*
+ * Simulates 100 prisoners problem "n" times with one process per NUMA node,
+ * each running threadsPerNode threads pinned to the node's CPUs, or one
+ * per CPU of the node if threadsPerNode is 0. Nodes claim batches of
+ * chunks from a queue shared by the processes, their threads claim the
+ * chunks of the batch, and each node sums its threads' results before
+ * writing them to the shared region.
+ */
+void simulateAndStatsHybrid(int n, int threadsPerNode);
+
+/*
+ * What a worker process of simulateChunksWithProcesses reports back, padded
+ * to a cache line so workers never write to the same line.
+ */
+struct workerSlot {
+    int pid;          // of the worker, until the parent reaps it
+    int chunks;       // chunks simulated, including copies that finished last
+    long simulations; // trials simulated, including copies that finished last
+    char padding[64 - 2*sizeof(int) - sizeof(long)];
+};
+
+/*
+ * Region shared by the parent and the worker processes of a run, backed by
+ * a memfd so that its file descriptor is all a worker needs, whether it was
+ * forked or spawned with --worker. It holds the options of the run the
+ * workers depend on, then one workerSlot per worker, then numSlots
+ * cycle histograms per worker with -H, then the chunkQueue. The workers
+ * need no state of their own beyond the region: every chunk is seeded
+ * from runSeed.
+ */
+struct processJob {
+    size_t size;             // of the whole region
+    size_t histogramsOffset; // from the start of the region, 0 without -H
+    size_t queueOffset;
+    uint64_t runSeed;
+    int numPrisoners;
+    int method;              // enum method_t
+    int antithetic;
+    int histograms;
+    int kMin;                // maxTrials of the first histogram slot
+    int numSlots;            // histograms of each worker
+    int numProcesses;
+    int open;                // the parent may add chunks, workers wait for them
+    int died;                // workers the parent reaped before the end
+    struct workerSlot workers[];
+};
+
+/*
+ * Claims and simulates chunks from the job's queue until every chunk is
+ * done and the job is no longer open, called by every worker process.
+ */
+void processChunks(struct processJob* job, int worker);
+
+/*
+ * Maps the job of the memfd "fd", takes the options of the run from it and
+ * works on its chunks as worker number "worker", then exits. This is what
+ * a worker spawned with --worker fd:worker runs.
+ */
+void runWorker(int fd, int worker);
+
+/*
+ * Distributions of the cycles of the trials, collected with -H. Stored
+ * results carry them as bins serialized with histogram_serialize, tagged
+ * with enum histogram_id.
+ */
+enum histogram_id {
+    HISTOGRAM_LONGEST,
+    HISTOGRAM_CYCLES,
+};
+
+struct cycleHistograms {
+    histogram longest; // length of the longest cycle of every trial
+    histogram cycles;  // number of cycles of every trial
+};
+
+/*
+ * Buffers a worker needs to simulate, allocated from an arena that is kept
+ * for the life of the worker so large buffers are only mapped once.
+ */
+struct workspace {
+    arena a;
+    set_union s;         // union find arrays
+    int* boxes;          // room of boxes for the naive and prefetch simulations
+    int* lengths;        // length of the segment starting at a box, for the prefetch simulation
+    packed_array perm;   // room of boxes for the packed simulation
+    uint64_t* visited;   // boxes already visited by the packed simulation
+    packed_array forest; // union find array for the packed union simulation
+    int* draws;          // numbers drawn for the trial or its antithetic pair, with -A or -H
+    struct cycleHistograms* hist; // cycles of the chunk being simulated, with -H
+    int* cycleBoxes;     // boxes of the trial, to walk its cycles with -H
+    uint64_t* cycleVisited;
+    int size;            // number of prisoners the buffers can hold, 0 if not initialized
+};
+
+/*
+ * Makes the workspace hold buffers for "size" prisoners. Must be called by
+ * the worker that uses the workspace, so its memory is local to the worker.
+ * The workspace must be zero initialized before the first call.
+ */
+void initWorkspace(struct workspace* w, int size);
+
+/*
+ * Simulates one trial with the kernel selected with -m, using the
+ * buffers of the workspace.
+ */
+enum found_t runKernel(struct workspace* w, int maxTrials);
+
+/*
+ * Simulates the problem once on a bit packed permutation: shuffles the
+ * boxes and walks every cycle once, failing as soon as a cycle is longer
+ * than maxTrials.
+ */
+enum found_t runPackedSimulation(struct workspace* w, int maxTrials);
+
+/*
+ * Simulates the problem once by walking the cycles of the shuffled boxes
+ * with PREFETCH_CURSORS cursors at once, so the cache misses of one cursor
+ * overlap with those of the others instead of stalling every step.
+ *
+ * Each cursor walks a segment from a box not walked yet up to the start of
+ * another segment, so segments split the cycles, and every cycle is the sum
+ * of the segments linked along it. Walked boxes are flagged in place, which
+ * limits the kernel to less than 2^30 prisoners. Fails as soon as a segment
+ * or a cycle is longer than maxTrials.
+ */
+enum found_t runPrefetchSimulation(struct workspace* w, int maxTrials);
+
+/*
+ * Simulates a chunk and returns its number of successes. With -H, the
+ * cycles of the chunk's trials are collected in w->hist.
+ *
+ * struct workspace* w holds the worker's buffers, reused across chunks.
+ *
+ * uint64_t key is the key of the stream the chunk's trials belong to.
+ *
+ * int* bothSucceeded, if not NULL, is set to the number of antithetic
+ * pairs of the chunk of which both trials succeeded.
+ */
+int simulateChunk(const struct chunk* c, struct workspace* w, uint64_t key, int* bothSucceeded);
+
+/*
+ * Simulates all chunks with numProcesses processes that claim chunks from a
+ * shared queue until it is empty, and stores the successes of each chunk
+ * back in chunks[]. All chunks with the same maxTrials share a stream
+ * derived from runSeed. Workers still busy with a chunk that another
+ * worker finished are killed rather than waited for.
+ *
+ * The workers are forked, or spawned as new processes with --spawn. Either
+ * way they share a single struct processJob with the parent.
+ *
+ * With -H, the cycles of the chunks with maxTrials k are added to
+ * hist[k - kMin], unless hist is NULL. Every worker collects them in
+ * histograms of its own, only for the copy of a chunk that finished first,
+ * and they are merged once the workers are done.
+ */
+void simulateChunksWithProcesses(struct chunk* chunks, int numChunks, int numProcesses,
+                                 uint64_t runSeed, struct cycleHistograms* hist, int kMin);
+
+/*
+ * Half width of the 95% CI of an estimate, smoothed by adding one success
+ * and one failure so estimates of 0 or 1 still have a non zero width.
+ */
+double estimatedHalfWidth(long successes, long n);
+
+/*
+ * A point of a sweep over the number of boxes each prisoner may open.
+ */
+struct sweepPoint {
+    int maxTrials;
+    long simulations;
+    long successes;
+    long previousSimulations; // stored results of the point, with -r
+    long previousSuccesses;
+};
+
+/*
+ * Estimates the success probability for every number of boxes opened in
+ * [kMin, kMax]. After a pilot chunk at every point, each round of chunks is
+ * given to the points whose CI is currently widest, until every point's CI
+ * half width is at most halfWidth or "budget" simulations were spent, the
+ * last chunk being cut to what is left of it. Exits if the budget cannot
+ * pay for the pilot chunks. Prints the estimate and the number of
+ * simulations spent at every point.
+ *
+ * The same numProcesses workers simulate every round, each round being
+ * added to the queue of their job once the previous one is done.
+ */
+void sweepWithProcesses(int kMin, int kMax, double halfWidth,
+                        long budget, int numProcesses);
+
+/*
+ * A simulation run as a job of an executor, yielding after every chunk.
+ * Its trials are seeded from "key" like the trials of a chunk.
+ */
+struct simJob {
+    struct job base; // must be first, the executor only sees this member
+    int id;
+    int numPrisoners;
+    int maxTrials;
+    long firstTrial; // index of the job's first trial in the run's stream
+    long numSimulations;
+    long done;       // number of simulations performed so far
+    long successes;
+    long bothSucceeded; // antithetic pairs of which both trials succeeded
+    uint64_t seed;   // seed of the run the job is part of
+    uint64_t key;    // key of the run's stream
+    double started;
+    void (*onDone)(struct simJob* job); // called by the thread finishing the job, may be NULL
+};
+
+/*
+ * Sets up a job simulating trials [firstTrial, firstTrial + numSimulations)
+ * of the stream of the run seeded with "seed".
+ */
+void initSimJob(struct simJob* job, int numPrisoners, int maxTrials,
+                long firstTrial, long numSimulations, uint64_t seed);
+
+/*
+ * Simulates "n" times sequentially, as a single chunk.
+ */
+void simulateSequentially(int n);
+
+/*
+ * Simulates the next chunk of the job, called by the executor.
+ */
+enum job_state resumeSimJob(struct job* j);
+
+/*
+ * Simulates 100 prisoners problem "n" times using numThreads threads.
+ * Same as simulateAndStatsWithProcesses, except the share of each thread is
+ * a job run by an executor with numThreads pinned threads.
+ */
+void simulateAndStatsWithThreads(int n, int numThreads);
+
+/*
+ * A share of a joint success run, as a job of an executor yielding after
+ * every chunk. Each thread counts its share in a matrix of its own, and
+ * the matrices are merged in a tree once every share is done.
+ */
+struct jointJob {
+    struct job base; // must be first, the executor only sees this member
+    int numPrisoners;
+    int maxTrials;
+    long firstTrial;       // index of the job's first trial in the run's stream
+    long numSimulations;
+    long done;             // number of simulations performed so far
+    uint64_t key;          // key of the run's stream
+    int* boxes;
+    uint64_t* visited;     // boxes of the cycles already walked
+    uint64_t* successes;   // bit t of word i: prisoner i found his tag in trial t
+    joint_matrix m;
+    struct jointJob* from; // job whose matrix is merged into this one's
+};
+
+/*
+ * Simulates the next chunk of the job, 64 trials at a time: every trial
+ * shuffles the boxes and walks their cycles, the prisoners on cycles of
+ * at most maxTrials boxes finding their tag.
+ */
+enum job_state resumeJointJob(struct job* j);
+
+/*
+ * Merges the matrix of job->from into the job's one.
+ */
+enum job_state mergeJointJob(struct job* j);
+
+/*
+ * Probability that two given prisoners both find their tag.
+ */
+double exactJointProbability(int numPrisoners, int maxTrials);
+
+/*
+ * Simulates "n" times with numThreads threads, counting for every pair of
+ * prisoners the trials in which both found their tag. Prints how far the
+ * pairs are from the exact joint probability and from independence, and
+ * writes the counts to the file given with -J.
+ */
+void jointWithThreads(int n, int numThreads);
+
+/*
+ * Reads jobs from stdin until EOF, one per line as
+ * "[numSimulations [numPrisoners [maxTrials]]]", and runs them with an
+ * executor of numThreads threads. Missing fields default to
+ * defaultNumSimulations, -n and -k (or half of numPrisoners if it is given).
+ * All queued jobs progress in turn, one chunk at a time, and each job's
+ * result is printed as soon as it is done.
+ */
+void runDaemon(long defaultNumSimulations, int numThreads);
+
+/*
+ * Maps the trace buffers of numWorkers workers named "workerName 1",
+ * "workerName 2", ..., plus one for the calling thread, named Main.
+ * Does nothing unless --trace was given. Must be called before the
+ * workers are created, workers then set traceWorker to their number.
+ */
+void startTrace(int numWorkers, const char* workerName);
+
+/*
+ * Records an event in the calling worker's trace buffer, if tracing.
+ */
+void traceEvent(enum trace_type type, uint64_t arg);
+
+/*
+ * Executor hooks that give every thread its trace buffer and record the
+ * time threads wait for a job.
+ */
+extern const struct executor_hooks traceHooks;
+
+/*
+ * Monotonic time in seconds.
+ */
+double now(void);
+
+/*
+ * Appends the result of a run of the selected kernel with PRNG "prng" to
+ * the results store, unless --no-store was given. Thread safe.
+ *
+ * uint64_t seed is the seed of the run.
+ *
+ * hist, if not NULL, is stored serialized in the bins of the record.
+ */
+void saveResult(int numPrisoners, int maxTrials, enum prng_t prng, uint64_t seed, long simulations,
+                long successes, double seconds, const struct cycleHistograms* hist);
+
+/*
+ * Sums the stored results of numPrisoners opening maxTrials boxes with the
+ * selected kernel and PRNG. Both are 0 if there are none.
+ */
+void storedResults(int numPrisoners, int maxTrials, long* simulations, long* successes);
+
+/*
+ * Whether a run seeded with "seed" of numPrisoners opening kMin to kMax
+ * boxes, with the selected kernel and PRNG, is already stored. Pooling its
+ * results with -r would count the same trials twice.
+ */
+int storedSeed(uint64_t seed, int kMin, int kMax);
+
+/*
+ * Prints the statistics of a run, also with the stored runs of the same
+ * configuration if -r was given, then stores the run with the cycles
+ * collected with -H, if hist is not NULL. With -A, also prints
+ * the CI computed from the means of the antithetic pairs, bothSucceeded
+ * being the number of pairs of which both trials succeeded.
+ */
+void reportRun(long sum, long bothSucceeded, long n, uint64_t seed, double seconds,
+               const struct cycleHistograms* hist, char* caller);
+
+/*
+ * Prints the mean and some quantiles of the cycles collected with -H.
+ */
+void printCycleHistograms(const struct cycleHistograms* hist);
+
+/*
+ * Prints the CI of n simulations in antithetic pairs from the pair means,
+ * and how many times smaller their variance is than that of n independent
+ * simulations.
+ */
+void printAntitheticStats(long sum, long bothSucceeded, long n);
+
+/*
+ * Prints the stored results of -n prisoners opening kMin to kMax boxes,
+ * for every kernel and PRNG, and pooled.
+ */
+void queryResults(int kMin, int kMax);
+
+/*
+ * Regenerates trial "index" of the run seeded with "seed", with the run's
+ * -n, -k, -m, -g and -A, and prints its cycles and the verdict of every
+ * kernel on it. Only the trials before it in its block are simulated again,
+ * since every block is seeded from its own key.
+ *
+ * char mode is the mode of the run: the trials of a c mode run use the PRNG
+ * of their chunk instead of -g. d and j mode runs cannot be replayed.
+ */
+void replayTrial(uint64_t seed, long index, char mode);
+
+/*
+ * Publishes the chunks of the queue done so far, on top of the runs already
+ * published, if --publish was given. With keep, they are added to the runs
+ * already published, once the queue is done.
+ */
+void publishProgress(const struct chunkQueue* q, int keep);
+
+/*
+ * Prints the snapshots published with --publish name until the run is over.
+ */
+void subscribeResults(const char* name);
+
+/*
+ * Writes the exact cycle tables for up to maxN boxes to the file given
+ * with --tables.
+ */
+void buildTables(int maxN);
+
+/*
+ * Prints, from the exact cycle tables, the distribution of the longest
+ * cycle of -n boxes for kMin to kMax boxes opened, which is the success
+ * probability of kMin to kMax boxes, and the distribution of the number
+ * of cycles.
+ */
+void printExact(int kMin, int kMax);
+
+/*
+ * Exact probability that every one of numPrisoners prisoners finds his tag
+ * opening maxTrials boxes. Uses the closed form when maxTrials is at least
+ * half of numPrisoners, a recurrence over the number of prisoners otherwise,
+ * and returns NAN if numPrisoners is too large for the recurrence.
+ */
+double exactProbability(int numPrisoners, int maxTrials);
+
+/*
+ * Probability that a chi-square distributed variable with degreesOfFreedom
+ * degrees of freedom is at least x.
+ */
+double chiSquarePValue(double x, int degreesOfFreedom);
+
+/*
+ * Simulates "n" times with numProcesses processes, the chunks of the run
+ * alternating between every PRNG, then prints every PRNG's estimate and
+ * its p-value against the exact probability, a chi-square test of the
+ * PRNGs' estimates being equal, and the pooled estimate. A PRNG with
+ * artifacts stands out in a single run instead of one run per PRNG.
+ */
+void consensusWithProcesses(int n, int numProcesses);
+
+void printUsage(void);
@@ -4,8 +4,9 @@
 #define ARRAY_SIZE (1 << 8)
 
 typedef unsigned char Uc;
-static Uc c;
-static unsigned int t[ARRAY_SIZE];
+// each thread has its own state
+static __thread Uc c;
+static __thread unsigned int t[ARRAY_SIZE];
 
 void Lfib4_seed(unsigned char seedVal, unsigned int* a) {
     c = seedVal;
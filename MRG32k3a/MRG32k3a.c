@@ -23,7 +23,8 @@ The seeds for s10, s11, s12 must be integers in [0, m1 - 1] and not all 0.
 The seeds for s20, s21, s22 must be integers in [0, m2 - 1] and not all 0. 
 ***/
 
-static double s10, s11, s12,
+// each thread has its own state
+static __thread double s10, s11, s12,
               s20, s21, s22;
 
 void mrg_seed(unsigned int s10p, unsigned int s11p, unsigned int s12p,
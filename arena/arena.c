@@ -0,0 +1,77 @@
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "arena.h"
+
+#define HUGEPAGE_SIZE (2UL << 20)
+#define PAGE_SIZE_4K (4UL << 10)
+#define ALIGNMENT 64 // cache line
+
+#ifndef MPOL_LOCAL
+#define MPOL_LOCAL 4
+#endif
+
+void arena_init(arena* a) {
+    a->base = NULL;
+    a->capacity = 0;
+    a->used = 0;
+    a->hugetlb = 0;
+}
+
+/*
+ * Makes sure at least "bytes" bytes can be allocated after the next reset.
+ * Growing the arena drops everything allocated from it.
+ * Returns 0 on success and -1 if the memory could not be mapped.
+ */
+int arena_reserve(arena* a, size_t bytes) {
+    if (bytes <= a->capacity) return 0;
+
+    arena_free(a);
+    size_t size = (bytes + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1);
+
+    char* base = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                      MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    a->hugetlb = base != MAP_FAILED;
+    if (base == MAP_FAILED) { // no reserved hugepages, fall back to THP
+        base = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) return -1;
+#ifdef MADV_HUGEPAGE
+        madvise(base, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    // keep the pages on the node of the calling worker, then fault them in
+    // now rather than during the first trial
+    syscall(SYS_mbind, base, size, MPOL_LOCAL, NULL, 0, 0);
+    for (size_t i = 0; i < size; i += PAGE_SIZE_4K) {
+        base[i] = 0;
+    }
+
+    a->base = base;
+    a->capacity = size;
+    a->used = 0;
+    return 0;
+}
+
+/*
+ * Returns "bytes" bytes aligned on a cache line, or NULL if the arena
+ * is full.
+ */
+void* arena_alloc(arena* a, size_t bytes) {
+    size_t start = (a->used + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    if (start + bytes > a->capacity) return NULL;
+    a->used = start + bytes;
+    return a->base + start;
+}
+
+void arena_reset(arena* a) {
+    a->used = 0;
+}
+
+void arena_free(arena* a) {
+    if (a->base != NULL) {
+        munmap(a->base, a->capacity);
+    }
+    arena_init(a);
+}
@@ -0,0 +1,24 @@
+#include <stddef.h>
+
+/*
+ * Bump allocator for the large simulation buffers of a worker.
+ * The memory is mapped with 2 MB hugepages when the system has some
+ * reserved (MAP_HUGETLB), otherwise transparent hugepages are requested
+ * with madvise. The pages are bound to the NUMA node of the worker that
+ * first reserves the arena, so a worker should reserve its own arena.
+ *
+ * The arena is meant to be reserved once and reset between trials or
+ * jobs, so the buffers are not mapped and faulted in again each time.
+ */
+typedef struct {
+    char* base;      // start of the mapping
+    size_t capacity; // number of bytes mapped
+    size_t used;     // number of bytes handed out since the last reset
+    int hugetlb;     // 1 if mapped from the reserved hugepages
+} arena;
+
+void arena_init(arena* a);
+int arena_reserve(arena* a, size_t bytes);
+void* arena_alloc(arena* a, size_t bytes);
+void arena_reset(arena* a);
+void arena_free(arena* a);
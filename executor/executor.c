@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <unistd.h>
+#include "executor.h"
+
+static struct job* pop(executor* e) {
+    struct job* j = e->head;
+    e->head = j->next;
+    if (e->head == NULL) e->tail = NULL;
+    return j;
+}
+
+static void push(executor* e, struct job* j) {
+    j->next = NULL;
+    if (e->tail != NULL) e->tail->next = j;
+    else e->head = j;
+    e->tail = j;
+}
+
+static void* workerLoop(void* arg) {
+    executor* e = ((struct executor_worker*)arg)->e;
+    int worker = ((struct executor_worker*)arg)->index;
+    const struct executor_hooks* hooks = e->hooks;
+
+    pthread_mutex_lock(&e->lock);
+    if (hooks != NULL && hooks->onStart != NULL) hooks->onStart(worker);
+    for (;;) {
+        if (e->head == NULL && !e->stopping && hooks != NULL && hooks->onStall != NULL) {
+            hooks->onStall(worker, 1);
+            while (e->head == NULL && !e->stopping) {
+                pthread_cond_wait(&e->ready, &e->lock);
+            }
+            hooks->onStall(worker, 0);
+        }
+        while (e->head == NULL && !e->stopping) {
+            pthread_cond_wait(&e->ready, &e->lock);
+        }
+        if (e->head == NULL) break; // stopping and nothing left to run
+
+        struct job* j = pop(e);
+        pthread_mutex_unlock(&e->lock);
+        enum job_state state = j->resume(j);
+        pthread_mutex_lock(&e->lock);
+
+        if (state == JOB_YIELD) {
+            push(e, j);
+        }
+        else if (--e->pending == 0) {
+            pthread_cond_broadcast(&e->idle);
+        }
+    }
+    pthread_mutex_unlock(&e->lock);
+    return NULL;
+}
+
+/*
+ * Starts numThreads workers, pinned in turn to the CPUs the calling thread
+ * may run on. hooks may be NULL, and must outlive the executor otherwise.
+ */
+void executor_init(executor* e, int numThreads, const struct executor_hooks* hooks) {
+    cpu_set_t allowed;
+    int cpuList[CPU_SETSIZE];
+    int numCpus = 0;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &allowed)) cpuList[numCpus++] = c;
+        }
+    }
+    if (numCpus == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int c = 0; c < online && c < CPU_SETSIZE; c++) {
+            cpuList[numCpus++] = c;
+        }
+        if (numCpus == 0) cpuList[numCpus++] = 0;
+    }
+
+    e->numThreads = numThreads;
+    e->threads = malloc(sizeof(pthread_t)*numThreads);
+    e->workers = malloc(sizeof(struct executor_worker)*numThreads);
+    if (e->threads == NULL || e->workers == NULL) {
+        perror("Couldn't allocate worker threads");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&e->lock, NULL);
+    pthread_cond_init(&e->ready, NULL);
+    pthread_cond_init(&e->idle, NULL);
+    e->head = e->tail = NULL;
+    e->pending = 0;
+    e->stopping = 0;
+    e->hooks = hooks;
+
+    // pinned before it starts, so a worker never allocates its memory from
+    // another CPU's node
+    for (int i = 0; i < numThreads; i++) {
+        pthread_attr_t attr;
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpuList[i % numCpus], &cpus);
+        pthread_attr_init(&attr);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+        e->workers[i] = (struct executor_worker){e, i};
+        if (pthread_create(&e->threads[i], &attr, workerLoop, &e->workers[i]) != 0) {
+            perror("Couldn't create worker thread");
+            exit(EXIT_FAILURE);
+        }
+        pthread_attr_destroy(&attr);
+    }
+}
+
+void executor_submit(executor* e, struct job* j) {
+    pthread_mutex_lock(&e->lock);
+    e->pending++;
+    push(e, j);
+    pthread_cond_signal(&e->ready);
+    pthread_mutex_unlock(&e->lock);
+}
+
+/*
+ * Waits until every job submitted so far is done.
+ */
+void executor_wait(executor* e) {
+    pthread_mutex_lock(&e->lock);
+    while (e->pending > 0) {
+        pthread_cond_wait(&e->idle, &e->lock);
+    }
+    pthread_mutex_unlock(&e->lock);
+}
+
+/*
+ * Lets the workers finish the queued jobs, then joins them.
+ */
+void executor_shutdown(executor* e) {
+    pthread_mutex_lock(&e->lock);
+    e->stopping = 1;
+    pthread_cond_broadcast(&e->ready);
+    pthread_mutex_unlock(&e->lock);
+
+    for (int i = 0; i < e->numThreads; i++) {
+        pthread_join(e->threads[i], NULL);
+    }
+    free(e->threads);
+    free(e->workers);
+    pthread_mutex_destroy(&e->lock);
+    pthread_cond_destroy(&e->ready);
+    pthread_cond_destroy(&e->idle);
+}
@@ -0,0 +1,64 @@
+#include <pthread.h>
+
+/*
+ * A job is a resumable computation: each call to resume runs it up to its
+ * next yield point, typically the end of a chunk of simulations, and
+ * returns JOB_YIELD to be put back at the end of the run queue, or
+ * JOB_DONE once finished. The executor never touches a job after it
+ * returned JOB_DONE, so resume may free it.
+ *
+ * Jobs are meant to be embedded as the first member of a larger struct
+ * holding their state.
+ */
+enum job_state {
+    JOB_YIELD,
+    JOB_DONE,
+};
+
+struct job {
+    enum job_state (*resume)(struct job* j);
+    struct job* next; // link in the run queue
+};
+
+/*
+ * Optional callbacks, called by worker number "worker" when it starts, and
+ * when it begins (begin = 1) and stops (begin = 0) waiting for a job.
+ */
+struct executor_hooks {
+    void (*onStart)(int worker);
+    void (*onStall)(int worker, int begin);
+};
+
+/*
+ * What a worker thread is started with, worker "index" runs on the index-th
+ * CPU of the pool, modulo their number.
+ */
+struct executor_worker {
+    struct executor* e;
+    int index;
+};
+
+/*
+ * Fixed pool of worker threads, each pinned to one of the CPUs the thread
+ * creating the pool may run on, resuming jobs from a single FIFO run queue.
+ * Since a yielding job goes back to the end of the queue, many queued jobs
+ * share the workers in turn.
+ */
+typedef struct executor {
+    pthread_t* threads;
+    struct executor_worker* workers;
+    int numThreads;
+    pthread_mutex_t lock;
+    pthread_cond_t ready; // a job was queued or the executor is stopping
+    pthread_cond_t idle;  // the last pending job finished
+    struct job* head;
+    struct job* tail;
+    int pending;          // jobs submitted and not done yet
+    int stopping;
+    const struct executor_hooks* hooks;
+} executor;
+
+void executor_init(executor* e, int numThreads, const struct executor_hooks* hooks);
+void executor_submit(executor* e, struct job* j);
+void executor_wait(executor* e);
+void executor_shutdown(executor* e);
@@ -0,0 +1,78 @@
+#include <string.h>
+#include "histogram.h"
+
+#define COUNT_BITS 40
+#define BIN_BITS 16
+
+void histogram_clear(histogram* h) {
+    memset(h, 0, sizeof(*h));
+}
+
+void histogram_merge(histogram* into, const histogram* from) {
+    if (from->total == 0) return;
+    if (into->total == 0 || from->min < into->min) into->min = from->min;
+    if (from->max > into->max) into->max = from->max;
+    for (int i = 0; i < HISTOGRAM_BINS; i++) {
+        into->counts[i] += from->counts[i];
+    }
+    into->total += from->total;
+}
+
+uint32_t histogram_low(int i) {
+    if (i < HISTOGRAM_SUB_BUCKETS) return i;
+    int shift = i/(HISTOGRAM_SUB_BUCKETS/2) - 1;
+    return (uint32_t)(i - shift*(HISTOGRAM_SUB_BUCKETS/2)) << shift;
+}
+
+uint32_t histogram_high(int i) {
+    if (i < HISTOGRAM_SUB_BUCKETS) return i;
+    int shift = i/(HISTOGRAM_SUB_BUCKETS/2) - 1;
+    return histogram_low(i) + ((1U << shift) - 1);
+}
+
+uint32_t histogram_quantile(const histogram* h, double q) {
+    uint64_t rank = q*h->total, seen = 0;
+    for (int i = 0; i < HISTOGRAM_BINS; i++) {
+        seen += h->counts[i];
+        if (seen > rank || (seen == h->total && seen > 0)) {
+            uint32_t v = histogram_high(i);
+            return v > h->max ? h->max : v < h->min ? h->min : v;
+        }
+    }
+    return 0;
+}
+
+double histogram_mean(const histogram* h) {
+    double sum = 0;
+    for (int i = 0; i < HISTOGRAM_BINS; i++) {
+        if (h->counts[i] > 0) {
+            sum += h->counts[i]*((histogram_low(i) + (double)histogram_high(i))/2);
+        }
+    }
+    return h->total > 0 ? sum/h->total : 0;
+}
+
+size_t histogram_serialize(const histogram* h, int id, uint64_t* words, size_t max) {
+    size_t n = 0;
+    for (int i = 0; i < HISTOGRAM_BINS && n < max; i++) {
+        if (h->counts[i] == 0) continue;
+        words[n++] = (uint64_t)id << (COUNT_BITS + BIN_BITS) |
+                     (uint64_t)i << COUNT_BITS |
+                     (h->counts[i] & ((1ULL << COUNT_BITS) - 1));
+    }
+    return n;
+}
+
+void histogram_deserialize(histogram* h, int id, const uint64_t* words, size_t n) {
+    for (size_t w = 0; w < n; w++) {
+        if ((int)(words[w] >> (COUNT_BITS + BIN_BITS)) != id) continue;
+        int i = (words[w] >> COUNT_BITS) & ((1 << BIN_BITS) - 1);
+        uint64_t count = words[w] & ((1ULL << COUNT_BITS) - 1);
+        if (i < HISTOGRAM_BINS && count > 0) {
+            if (h->total == 0 || histogram_low(i) < h->min) h->min = histogram_low(i);
+            if (histogram_high(i) > h->max) h->max = histogram_high(i);
+            h->counts[i] += count;
+            h->total += count;
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Histogram of 32 bit values in the spirit of HdrHistogram: values below
+ * HISTOGRAM_SUB_BUCKETS have a bin each, and every power of 2 above them is
+ * split in HISTOGRAM_SUB_BUCKETS/2 bins of equal width, so a value is off
+ * by less than 2/HISTOGRAM_SUB_BUCKETS of itself (about 6%).
+ *
+ * The bins of all 32 bit values take less than 4 KB whatever the largest
+ * value, so a histogram stays in the L1 or L2 cache, and merging two is a
+ * single pass over the bins.
+ */
+#define HISTOGRAM_PRECISION 5 // log2 of HISTOGRAM_SUB_BUCKETS
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_PRECISION)
+#define HISTOGRAM_BINS ((32 - HISTOGRAM_PRECISION + 1)*HISTOGRAM_SUB_BUCKETS/2 + HISTOGRAM_SUB_BUCKETS/2)
+
+typedef struct {
+    uint64_t total; // number of values added
+    uint32_t min;   // smallest and largest value added, exact
+    uint32_t max;
+    uint64_t counts[HISTOGRAM_BINS];
+} histogram;
+
+void histogram_clear(histogram* h);
+
+/*
+ * Adds the counts of "from" to "into".
+ */
+void histogram_merge(histogram* into, const histogram* from);
+
+/*
+ * Smallest and largest value of bin i.
+ */
+uint32_t histogram_low(int i);
+uint32_t histogram_high(int i);
+
+/*
+ * Smallest value v such that a fraction q of the values are at most v,
+ * up to the width of its bin but never beyond the smallest and largest
+ * values added. 0 if the histogram is empty.
+ */
+uint32_t histogram_quantile(const histogram* h, double q);
+
+/*
+ * Mean of the values, each counted as the middle of its bin.
+ */
+double histogram_mean(const histogram* h);
+
+/*
+ * Writes the non empty bins of h tagged with "id", one word per bin:
+ * the id in the top 8 bits, the bin in the next 16 and its count in the
+ * lower 40. Returns the number of words written, at most "max" words
+ * are written.
+ */
+size_t histogram_serialize(const histogram* h, int id, uint64_t* words, size_t max);
+
+/*
+ * Adds the bins tagged with "id" among the n words to h. The smallest and
+ * largest values are only known up to the width of their bins.
+ */
+void histogram_deserialize(histogram* h, int id, const uint64_t* words, size_t n);
+
+static inline int histogram_bin(uint32_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) return value;
+    int shift = (31 - __builtin_clz(value)) - HISTOGRAM_PRECISION + 1;
+    return shift*(HISTOGRAM_SUB_BUCKETS/2) + (value >> shift);
+}
+
+static inline void histogram_add(histogram* h, uint32_t value) {
+    h->counts[histogram_bin(value)]++;
+    if (h->total++ == 0 || value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
@@ -0,0 +1,45 @@
+#include <stdlib.h>
+
+#include "joint.h"
+
+#define JOINT_TILE 64
+
+int joint_init(joint_matrix* m, int n) {
+    m->counts = calloc((size_t)n*(n + 1)/2, sizeof(uint32_t));
+    m->n = n;
+    m->trials = 0;
+    return m->counts == NULL ? -1 : 0;
+}
+
+void joint_add(joint_matrix* m, const uint64_t* successes, int numTrials) {
+    int n = m->n;
+
+    for (int ti=0; ti<n; ti+=JOINT_TILE) {
+        int iEnd = ti + JOINT_TILE < n ? ti + JOINT_TILE : n;
+        for (int tj=ti; tj<n; tj+=JOINT_TILE) {
+            int jEnd = tj + JOINT_TILE < n ? tj + JOINT_TILE : n;
+            for (int i=ti; i<iEnd; i++) {
+                uint64_t wi = successes[i];
+                if (wi == 0) continue; // prisoner i failed in every trial
+                uint32_t* row = m->counts + joint_index(n, i, 0);
+                for (int j=(tj > i ? tj : i); j<jEnd; j++) {
+                    row[j] += __builtin_popcountll(wi & successes[j]);
+                }
+            }
+        }
+    }
+    m->trials += numTrials;
+}
+
+void joint_merge(joint_matrix* into, const joint_matrix* from) {
+    size_t size = (size_t)into->n*(into->n + 1)/2;
+    for (size_t i=0; i<size; i++) {
+        into->counts[i] += from->counts[i];
+    }
+    into->trials += from->trials;
+}
+
+void joint_free(joint_matrix* m) {
+    free(m->counts);
+    m->counts = NULL;
+}
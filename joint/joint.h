@@ -0,0 +1,44 @@
+#include <stdint.h>
+
+/*
+ * Counts of the trials in which prisoner i and prisoner j both found their
+ * tag, for every pair i <= j, so the diagonal holds each prisoner's own
+ * count. Only the upper triangle is stored, row after row, in 32 bit
+ * counts since a run has fewer than 2^31 trials.
+ */
+typedef struct {
+    uint32_t* counts;
+    int n;       // num of prisoners
+    long trials; // num of trials added
+} joint_matrix;
+
+/*
+ * Allocates a zeroed matrix for n prisoners, returns -1 if it couldn't.
+ */
+int joint_init(joint_matrix* m, int n);
+
+/*
+ * Adds up to 64 trials at once: bit t of successes[i] is set if prisoner i
+ * found his tag in trial t. Each pair costs a single popcount for all the
+ * trials, the pairs being visited in tiles so the words of both prisoners
+ * stay in the L1 cache.
+ */
+void joint_add(joint_matrix* m, const uint64_t* successes, int numTrials);
+
+/*
+ * Adds the counts of "from" to "into", both for the same number of prisoners.
+ */
+void joint_merge(joint_matrix* into, const joint_matrix* from);
+
+void joint_free(joint_matrix* m);
+
+/*
+ * Index of the pair (i, j), i <= j, in the counts.
+ */
+static inline long joint_index(int n, long i, long j) {
+    return i*n - i*(i - 1)/2 + (j - i);
+}
+
+static inline uint32_t joint_count(const joint_matrix* m, int i, int j) {
+    return i <= j ? m->counts[joint_index(m->n, i, j)] : m->counts[joint_index(m->n, j, i)];
+}
@@ -0,0 +1,18 @@
+#include "packed.h"
+
+int packed_bits_for(uint64_t maxValue) {
+    int bits = 1;
+    while (bits < 63 && (maxValue >> bits) != 0) bits++;
+    return bits;
+}
+
+size_t packed_bytes(long n, int bits) {
+    return (((uint64_t)n * bits + 63) / 64 + 1) * sizeof(uint64_t);
+}
+
+void packed_init(packed_array* a, uint64_t* words, long n, int bits) {
+    a->words = words;
+    a->bits = bits;
+    a->mask = (1ULL << bits) - 1;
+    a->n = n;
+}
@@ -0,0 +1,65 @@
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Array of n unsigned integers of "bits" bits each, packed back to back in
+ * 64 bit words, so an element may straddle two words. The words are owned
+ * by the caller and must hold packed_bytes(n, bits) bytes.
+ */
+typedef struct {
+    uint64_t* words;
+    uint64_t mask; // (1 << bits) - 1
+    int bits;      // bits per element, 1 to 63
+    long n;        // num of elements
+} packed_array;
+
+/*
+ * Number of bits needed to store every value in [0, maxValue].
+ */
+int packed_bits_for(uint64_t maxValue);
+
+/*
+ * Number of bytes needed for n elements of "bits" bits. One spare word is
+ * included so the last element can always be read as two words.
+ */
+size_t packed_bytes(long n, int bits);
+
+/*
+ * Attaches the words to the array, the elements are left as they were.
+ */
+void packed_init(packed_array* a, uint64_t* words, long n, int bits);
+
+static inline uint64_t packed_get(const packed_array* a, long i) {
+    uint64_t bit = (uint64_t)i * a->bits;
+    const uint64_t* w = a->words + (bit >> 6);
+    unsigned offset = bit & 63;
+
+    uint64_t value = w[0] >> offset;
+    if (offset + a->bits > 64) {
+        value |= w[1] << (64 - offset);
+    }
+    return value & a->mask;
+}
+
+static inline void packed_set(packed_array* a, long i, uint64_t value) {
+    uint64_t bit = (uint64_t)i * a->bits;
+    uint64_t* w = a->words + (bit >> 6);
+    unsigned offset = bit & 63;
+
+    w[0] = (w[0] & ~(a->mask << offset)) | (value << offset);
+    if (offset + a->bits > 64) {
+        unsigned high = 64 - offset; // bits of the element stored in w[0]
+        w[1] = (w[1] & ~(a->mask >> high)) | (value >> high);
+    }
+}
+
+/*
+ * Bitsets of one bit per element, used next to packed arrays.
+ */
+static inline int bitset_test(const uint64_t* set, long i) {
+    return (set[i >> 6] >> (i & 63)) & 1;
+}
+
+static inline void bitset_set(uint64_t* set, long i) {
+    set[i >> 6] |= 1ULL << (i & 63);
+}
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "publish.h"
+
+/*
+ * Segment names start with a single slash.
+ */
+static void segmentName(char* out, size_t size, const char* name) {
+    snprintf(out, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+int publish_open(publisher* p, const char* name) {
+    segmentName(p->name, sizeof(p->name), name);
+    int fd = shm_open(p->name, O_RDWR|O_CREAT, 0644);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, sizeof(struct publish_segment)) != 0) {
+        close(fd);
+        return -1;
+    }
+    p->segment = mmap(NULL, sizeof(struct publish_segment),
+                      PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p->segment == MAP_FAILED) {
+        p->segment = NULL;
+        return -1;
+    }
+
+    // an odd sequence keeps readers out until the first snapshot
+    __atomic_store_n(&p->segment->sequence, 1, __ATOMIC_RELAXED);
+    memset(&p->segment->snapshot, 0, sizeof(p->segment->snapshot));
+    p->segment->magic = PUBLISH_MAGIC;
+    p->segment->version = PUBLISH_VERSION;
+    __atomic_store_n(&p->segment->sequence, 2, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void publish_write(publisher* p, const struct publish_snapshot* s) {
+    uint64_t sequence = __atomic_load_n(&p->segment->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&p->segment->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    p->segment->snapshot = *s;
+    __atomic_store_n(&p->segment->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void publish_close(publisher* p) {
+    munmap(p->segment, sizeof(struct publish_segment));
+    shm_unlink(p->name);
+    p->segment = NULL;
+}
+
+int subscribe_open(subscriber* s, const char* name) {
+    char path[256];
+    segmentName(path, sizeof(path), name);
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct publish_segment)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    s->segment = mmap(NULL, sizeof(struct publish_segment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (s->segment == MAP_FAILED) {
+        s->segment = NULL;
+        return -1;
+    }
+    if (s->segment->magic != PUBLISH_MAGIC || s->segment->version != PUBLISH_VERSION) {
+        subscribe_close(s);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+void subscribe_read(const subscriber* s, struct publish_snapshot* out) {
+    for (;;) {
+        uint64_t before = __atomic_load_n(&s->segment->sequence, __ATOMIC_ACQUIRE);
+        if (before % 2 == 0) {
+            *out = s->segment->snapshot;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&s->segment->sequence, __ATOMIC_RELAXED) == before) return;
+        }
+        sched_yield(); // the writer is in the middle of a snapshot
+    }
+}
+
+void subscribe_close(subscriber* s) {
+    munmap((void*)s->segment, sizeof(struct publish_segment));
+    s->segment = NULL;
+}
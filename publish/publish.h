@@ -0,0 +1,73 @@
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Live snapshot of a run in a named POSIX shared memory segment
+ * (/dev/shm/name), written by the run and mapped read only by any number
+ * of local subscribers.
+ *
+ * The snapshot is protected by a seqlock: the writer makes the sequence
+ * odd, updates the snapshot and makes it even again, and a reader retries
+ * its copy until it saw the same even sequence before and after. Readers
+ * never write to the segment, so they cannot slow the run down.
+ */
+#define PUBLISH_MAGIC 0x4C495645 // "LIVE"
+#define PUBLISH_VERSION 1
+#define PUBLISH_BINS 20
+
+struct publish_snapshot {
+    int32_t numPrisoners;
+    int32_t maxTrials;
+    uint32_t done;        // 1 once the run is over
+    uint32_t numBins;
+    uint64_t simulations; // simulations done so far
+    uint64_t successes;
+    double seconds;       // since the run started
+    double rate;          // simulations per second since the run started
+    uint64_t bins[PUBLISH_BINS]; // chunks done, by their estimate in [i/numBins, (i+1)/numBins)
+};
+
+struct publish_segment {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sequence; // odd while the snapshot is being written
+    struct publish_snapshot snapshot;
+};
+
+typedef struct {
+    struct publish_segment* segment;
+    char name[256];
+} publisher;
+
+typedef struct {
+    const struct publish_segment* segment;
+} subscriber;
+
+/*
+ * Creates, or takes over, the segment "name". Returns 0, or -1 with errno set.
+ */
+int publish_open(publisher* p, const char* name);
+
+/*
+ * Replaces the published snapshot, only one thread may publish at a time.
+ */
+void publish_write(publisher* p, const struct publish_snapshot* s);
+
+/*
+ * Unmaps the segment, and removes its name so no new subscriber finds it.
+ * Subscribers that mapped it keep their mapping.
+ */
+void publish_close(publisher* p);
+
+/*
+ * Maps the segment "name" read only. Returns 0, or -1 with errno set,
+ * EINVAL if it is not a segment of this version.
+ */
+int subscribe_open(subscriber* s, const char* name);
+
+/*
+ * Copies a consistent snapshot, waiting for the writer if needed.
+ */
+void subscribe_read(const subscriber* s, struct publish_snapshot* out);
+
+void subscribe_close(subscriber* s);
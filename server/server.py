@@ -5,6 +5,9 @@ app = Flask(__name__)
 
 output = ""
 
+# the store the command line uses by default, run from the repository root
+STORE = "../results.log"
+
 @app.route('/')
 def index():
     return render_template('index.html')
@@ -20,9 +23,29 @@ def simulation_page():
     #    return render_template('simulation_page.html', output=output)
     return render_template('simulation_page.html', output=output)
 
+@app.route('/results')
+def results():
+    # stored results, so known configurations are answered without simulating
+    n = request.args.get('n', 100, type=int)
+    k = request.args.get('k', n // 2, type=int)
+    stored = check_output(["../100prisoners", "-o", STORE, "-n", str(n), "-k", str(k), "q"]).decode().\
+             replace('\n', '<br>')
+    return render_template('simulation_page.html', output=stored)
+
+@app.route('/exact')
+def exact():
+    # exact distributions, looked up in the tables built with --build-tables
+    n = request.args.get('n', 100, type=int)
+    args = ["../100prisoners", "--tables", "../tables.bin", "-n", str(n), "--exact"]
+    if 'k' in request.args:
+        args[-1:-1] = ["-k", str(request.args.get('k', type=int))]
+    table = check_output(args).decode().replace('\n', '<br>')
+    return render_template('simulation_page.html', output=table)
+
 def simulate():
     global output
-    output = check_output(["../100prisoners", "83000000", "p", "4"]).decode().\
+    # -r adds the results stored by previous runs to this run's estimate
+    output = check_output(["../100prisoners", "-o", STORE, "-r", "83000000", "p", "4"]).decode().\
              replace('\n', '<br>')
 
 
@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "store.h"
+
+#define INITIAL_CAPACITY 256
+#define RESYNC_BUFFER 4096
+
+static struct store_index_entry* entriesOf(struct store_index_header* h) {
+    return (struct store_index_entry*)(h + 1);
+}
+
+static size_t indexBytes(uint32_t capacity) {
+    return sizeof(struct store_index_header) + sizeof(struct store_index_entry)*capacity;
+}
+
+static uint64_t hashKey(const struct store_key* key) {
+    uint64_t h = 1469598103934665603ULL; // FNV-1a
+    const unsigned char* bytes = (const unsigned char*)key;
+    for (size_t i = 0; i < sizeof(*key); i++) {
+        h = (h ^ bytes[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static void unmapIndex(store* s) {
+    if (s->index != NULL) munmap(s->index, s->indexSize);
+    s->index = NULL;
+    if (s->indexFd >= 0) close(s->indexFd);
+    s->indexFd = -1;
+}
+
+/*
+ * Maps the index at s->indexPath if it is a valid index, returns -1 if it
+ * is missing or not valid.
+ */
+static int openIndex(store* s) {
+    unmapIndex(s);
+    s->indexFd = open(s->indexPath, O_RDWR);
+    if (s->indexFd < 0) return -1;
+
+    struct stat st;
+    struct store_index_header h;
+    if (fstat(s->indexFd, &st) == 0 && st.st_size >= (off_t)sizeof(h) &&
+        pread(s->indexFd, &h, sizeof(h), 0) == sizeof(h) &&
+        h.magic == STORE_MAGIC && h.version == STORE_VERSION &&
+        h.capacity >= INITIAL_CAPACITY && (h.capacity & (h.capacity - 1)) == 0 &&
+        (size_t)st.st_size == indexBytes(h.capacity)) {
+        s->indexSize = st.st_size;
+        s->index = mmap(NULL, s->indexSize, PROT_READ|PROT_WRITE, MAP_SHARED, s->indexFd, 0);
+        if (s->index != MAP_FAILED) return 0;
+        s->index = NULL;
+    }
+    unmapIndex(s);
+    return -1;
+}
+
+/*
+ * Maps the index again if another process replaced it since it was
+ * mapped. Called with the log locked.
+ */
+static int refreshIndex(store* s) {
+    struct stat mapped, current;
+    if (s->index != NULL && fstat(s->indexFd, &mapped) == 0 && stat(s->indexPath, &current) == 0 &&
+        mapped.st_ino == current.st_ino && mapped.st_dev == current.st_dev) {
+        return 0;
+    }
+    return openIndex(s);
+}
+
+static struct store_index_entry* findEntry(struct store_index_header* h,
+                                           const struct store_key* key) {
+    uint32_t mask = h->capacity - 1;
+    uint32_t i = hashKey(key) & mask;
+    struct store_index_entry* entries = entriesOf(h);
+
+    while (entries[i].used && memcmp(&entries[i].key, key, sizeof(*key)) != 0) {
+        i = (i + 1) & mask; // linear probing
+    }
+    return &entries[i];
+}
+
+static void indexRecord(store* s, const struct store_record* r, uint64_t offset) {
+    struct store_index_entry* e = findEntry(s->index, &r->key);
+    if (!e->used) {
+        e->used = 1;
+        e->key = r->key;
+        s->index->count++;
+    }
+    e->numRecords++;
+    e->simulations += r->simulations;
+    e->successes += r->successes;
+    e->lastOffset = offset;
+}
+
+/*
+ * Whether a whole valid record starts at "offset" of a log of "size" bytes.
+ */
+static int readRecord(store* s, uint64_t offset, uint64_t size, struct store_record* r) {
+    return offset + sizeof(*r) <= size &&
+           pread(s->logFd, r, sizeof(*r), offset) == sizeof(*r) &&
+           r->magic == STORE_MAGIC && r->version == STORE_VERSION &&
+           r->length == sizeof(*r) + sizeof(uint64_t)*r->numBins &&
+           offset + r->length <= size;
+}
+
+/*
+ * Offset of the first valid record after the torn one at "offset", or
+ * "size" if there is none.
+ */
+static uint64_t resync(store* s, uint64_t offset, uint64_t size) {
+    const uint32_t magic = STORE_MAGIC;
+    unsigned char buf[RESYNC_BUFFER];
+    struct store_record r;
+
+    for (uint64_t start = offset + 1; start < size; start += sizeof(buf) - sizeof(magic) + 1) {
+        ssize_t n = pread(s->logFd, buf, sizeof(buf), start);
+        if (n < (ssize_t)sizeof(magic)) break;
+        for (ssize_t i = 0; i + (ssize_t)sizeof(magic) <= n; i++) {
+            if (memcmp(buf + i, &magic, sizeof(magic)) == 0 && readRecord(s, start + i, size, &r)) {
+                return start + i;
+            }
+        }
+    }
+    return size;
+}
+
+/*
+ * Adds the records the index does not account for yet. Records torn by a
+ * writer that died are skipped, and dropped from the log if nothing was
+ * appended after them. Returns 1 if the index is too full to add the next
+ * record. Called with the log locked exclusively.
+ */
+static int catchUp(store* s) {
+    struct stat st;
+    if (fstat(s->logFd, &st) != 0) return -1;
+
+    uint64_t size = st.st_size;
+    uint64_t offset = s->index->logSize;
+    while (offset < size) {
+        struct store_record r;
+        if (!readRecord(s, offset, size, &r)) { // torn write
+            uint64_t next = resync(s, offset, size);
+            if (next == size) {
+                if (ftruncate(s->logFd, offset) != 0) return -1;
+                break;
+            }
+            offset = next;
+            s->index->logSize = offset;
+            continue;
+        }
+        if ((s->index->count + 1)*2 > s->index->capacity) return 1;
+
+        indexRecord(s, &r, offset);
+        offset += r.length;
+        s->index->logSize = offset;
+    }
+    return 0;
+}
+
+/*
+ * Builds an index of the whole log with room for at least "capacity"
+ * entries in a new file, then renames it over the current index, so the
+ * processes that still map the old one keep reading a valid index. Called
+ * with the log locked exclusively.
+ */
+static int rebuildIndex(store* s, uint32_t capacity) {
+    char tmpPath[strlen(s->indexPath) + sizeof(".tmp")];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", s->indexPath);
+
+    for (;;) {
+        unmapIndex(s);
+        s->indexSize = indexBytes(capacity);
+        s->indexFd = open(tmpPath, O_RDWR|O_CREAT|O_TRUNC, 0644);
+        if (s->indexFd < 0 || ftruncate(s->indexFd, s->indexSize) != 0) return -1;
+        s->index = mmap(NULL, s->indexSize, PROT_READ|PROT_WRITE, MAP_SHARED, s->indexFd, 0);
+        if (s->index == MAP_FAILED) {
+            s->index = NULL;
+            return -1;
+        }
+        s->index->magic = STORE_MAGIC;
+        s->index->version = STORE_VERSION;
+        s->index->capacity = capacity;
+
+        int status = catchUp(s);
+        if (status < 0) return -1;
+        if (status == 0) break;
+        capacity *= 2;
+    }
+    return rename(tmpPath, s->indexPath);
+}
+
+/*
+ * Makes the mapped index the current one and up to date with the log.
+ * Called with the log locked exclusively.
+ */
+static int updateIndex(store* s) {
+    if (refreshIndex(s) != 0) return rebuildIndex(s, INITIAL_CAPACITY);
+
+    int status = catchUp(s);
+    if (status > 0) return rebuildIndex(s, s->index->capacity*2);
+    return status;
+}
+
+/*
+ * Opens or creates the store at "path".
+ * Returns 0 on success and -1 on failure, with errno set.
+ */
+int store_open(store* s, const char* path) {
+    s->index = NULL;
+    s->indexFd = -1;
+    s->indexPath = malloc(strlen(path) + sizeof(".idx"));
+    if (s->indexPath == NULL) return -1;
+    sprintf(s->indexPath, "%s.idx", path);
+
+    s->logFd = open(path, O_RDWR|O_CREAT|O_APPEND, 0644);
+    if (s->logFd < 0) {
+        free(s->indexPath);
+        return -1;
+    }
+
+    flock(s->logFd, LOCK_EX);
+    int status = updateIndex(s);
+    flock(s->logFd, LOCK_UN);
+
+    if (status != 0) {
+        store_close(s);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Appends a record and its histogram bins to the log and adds it to the
+ * index. The magic, version and length of the record are filled in.
+ */
+int store_append(store* s, const struct store_record* r, const uint64_t* bins) {
+    struct store_record header = *r;
+    header.magic = STORE_MAGIC;
+    header.version = STORE_VERSION;
+    header.length = sizeof(header) + sizeof(uint64_t)*r->numBins;
+
+    char buf[header.length];
+    memcpy(buf, &header, sizeof(header));
+    if (r->numBins > 0) memcpy(buf + sizeof(header), bins, sizeof(uint64_t)*r->numBins);
+
+    flock(s->logFd, LOCK_EX);
+    int status = updateIndex(s); // other processes may have appended
+    if (status == 0 && write(s->logFd, buf, header.length) != (ssize_t)header.length) {
+        status = -1;
+    }
+    if (status == 0) status = updateIndex(s);
+    flock(s->logFd, LOCK_UN);
+    return status;
+}
+
+/*
+ * Copies the aggregated results of "key" to *entry. Returns 1 if there are
+ * some, 0 if there are none and -1 if the index could not be read.
+ */
+int store_lookup(store* s, const struct store_key* key, struct store_index_entry* entry) {
+    flock(s->logFd, LOCK_SH);
+    int found = refreshIndex(s) == 0 ? 0 : -1;
+    if (found == 0) {
+        *entry = *findEntry(s->index, key);
+        found = entry->used;
+    }
+    flock(s->logFd, LOCK_UN);
+    return found;
+}
+
+/*
+ * Returns a copy of the used entries of the index, to be freed by the
+ * caller, and their number in *count. NULL if the index could not be read.
+ */
+struct store_index_entry* store_entries(store* s, uint32_t* count) {
+    struct store_index_entry* copy = NULL;
+    *count = 0;
+
+    flock(s->logFd, LOCK_SH);
+    if (refreshIndex(s) == 0 && (copy = malloc(sizeof(*copy)*(s->index->count + 1))) != NULL) {
+        const struct store_index_entry* entries = entriesOf(s->index);
+        for (uint32_t i = 0; i < s->index->capacity && *count < s->index->count; i++) {
+            if (entries[i].used) copy[(*count)++] = entries[i];
+        }
+    }
+    flock(s->logFd, LOCK_UN);
+    return copy;
+}
+
+static int hasKey(const struct store_key* keys, uint32_t numKeys, const struct store_key* key) {
+    for (uint32_t i = 0; i < numKeys; i++) {
+        if (memcmp(&keys[i], key, sizeof(*key)) == 0) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Reads the histogram bins of every record of the numKeys "keys" into
+ * *bins, to be freed by the caller, and their number in *numBins. The index
+ * does not keep them, so the log is read, once for all the keys. Returns
+ * -1 if it could not be read.
+ */
+int store_bins(store* s, const struct store_key* keys, uint32_t numKeys, uint64_t** bins,
+               uint32_t* numBins) {
+    *bins = NULL;
+    *numBins = 0;
+
+    flock(s->logFd, LOCK_SH);
+    int status = refreshIndex(s);
+    uint64_t size = status == 0 ? s->index->logSize : 0;
+    uint64_t offset = 0;
+    while (status == 0 && offset < size) {
+        struct store_record r;
+        if (!readRecord(s, offset, size, &r)) { // torn write
+            offset = resync(s, offset, size);
+            continue;
+        }
+        if (r.numBins > 0 && hasKey(keys, numKeys, &r.key)) {
+            size_t bytes = sizeof(uint64_t)*r.numBins;
+            uint64_t* grown = realloc(*bins, sizeof(uint64_t)*(*numBins + r.numBins));
+            if (grown == NULL) {
+                status = -1;
+                break;
+            }
+            *bins = grown;
+            if (pread(s->logFd, *bins + *numBins, bytes, offset + sizeof(r)) != (ssize_t)bytes) {
+                status = -1;
+                break;
+            }
+            *numBins += r.numBins;
+        }
+        offset += r.length;
+    }
+    flock(s->logFd, LOCK_UN);
+
+    if (status != 0) {
+        free(*bins);
+        *bins = NULL;
+        *numBins = 0;
+    }
+    return status;
+}
+
+/*
+ * Whether one of the numKeys "keys" has a record of a run seeded with
+ * "seed". Returns 1 if so, 0 if not and -1 if the log could not be read.
+ */
+int store_seeded(store* s, const struct store_key* keys, uint32_t numKeys, uint64_t seed) {
+    flock(s->logFd, LOCK_SH);
+    int found = refreshIndex(s);
+    uint64_t size = found == 0 ? s->index->logSize : 0;
+    uint64_t offset = 0;
+    while (found == 0 && offset < size) {
+        struct store_record r;
+        if (!readRecord(s, offset, size, &r)) { // torn write
+            offset = resync(s, offset, size);
+            continue;
+        }
+        found = r.seed == seed && hasKey(keys, numKeys, &r.key);
+        offset += r.length;
+    }
+    flock(s->logFd, LOCK_UN);
+    return found;
+}
+
+void store_close(store* s) {
+    unmapIndex(s);
+    close(s->logFd);
+    free(s->indexPath);
+}
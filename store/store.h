@@ -0,0 +1,79 @@
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Append-only log of simulation results, with an index mapped in memory
+ * that aggregates the results of every configuration.
+ *
+ * The log at "path" is a sequence of records, each a struct store_record
+ * followed by numBins histogram bins. It is only ever appended to, so it
+ * is the reference: the index at "path.idx" is rebuilt from it whenever it
+ * is missing, corrupt or behind.
+ *
+ * The log is locked with flock, exclusively to write either file and shared
+ * to read the index, so several processes may share a store. The index is
+ * never resized in place: it grows by building a larger one in
+ * "path.idx.tmp" renamed over the old one, and every handle maps the new
+ * index once it sees the old one was replaced. A store handle must not be
+ * used by several threads at once.
+ */
+#define STORE_MAGIC 0x50524953 // "PRIS"
+#define STORE_VERSION 1
+
+/*
+ * Configuration the results of a run are aggregated under.
+ */
+struct store_key {
+    int32_t numPrisoners;
+    int32_t maxTrials;
+    int32_t method; // kernel used, enum method_t
+    int32_t prng;   // PRNG used, enum prng_t
+};
+
+struct store_record {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t length;     // bytes of the record, including the bins
+    uint32_t numBins;    // histogram bins following the record
+    struct store_key key;
+    uint64_t seed;       // seed of the run's streams
+    uint64_t simulations;
+    uint64_t successes;
+    double seconds;      // wall time of the run
+    int64_t time;        // unix time when the run ended
+    char build[64];      // build id of the simulator
+};
+
+struct store_index_entry {
+    struct store_key key;
+    uint32_t used;
+    uint32_t numRecords;
+    uint64_t simulations; // summed over every record of the key
+    uint64_t successes;
+    uint64_t lastOffset;  // offset of the key's last record in the log
+};
+
+struct store_index_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity; // number of entries, a power of 2
+    uint32_t count;    // number of entries used
+    uint64_t logSize;  // bytes of the log the index accounts for
+};
+
+typedef struct {
+    int logFd;
+    int indexFd;
+    struct store_index_header* index; // mapped index file
+    size_t indexSize;
+    char* indexPath;
+} store;
+
+int store_open(store* s, const char* path);
+int store_append(store* s, const struct store_record* r, const uint64_t* bins);
+int store_lookup(store* s, const struct store_key* key, struct store_index_entry* entry);
+struct store_index_entry* store_entries(store* s, uint32_t* count);
+int store_bins(store* s, const struct store_key* keys, uint32_t numKeys, uint64_t** bins,
+               uint32_t* numBins);
+int store_seeded(store* s, const struct store_key* keys, uint32_t numKeys, uint64_t seed);
+void store_close(store* s);
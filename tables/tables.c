@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tables.h"
+
+#define LONGEST_LANES 8 // sequences of k computed in lockstep
+
+void tables_longest_sequence(double* p, double* suffix, int maxN, int k) {
+    double prefix = 0; // sum of the current block up to m-1
+    int blockStart = 0;
+
+    p[0] = 1;
+    for (int m=1; m<=maxN; m++) {
+        if (m - 1 - blockStart == k) { // the block [blockStart, m-2] is complete
+            double sum = 0;
+            for (int i=k-1; i>=0; i--) {
+                sum += p[blockStart + i];
+                suffix[i] = sum;
+            }
+            blockStart = m - 1;
+            prefix = 0;
+        }
+        prefix += p[m - 1];
+
+        // the window [m-k, m-1] starts m - blockStart into the previous block
+        double window = prefix;
+        if (blockStart > 0 && m - blockStart < k) window += suffix[m - blockStart];
+        p[m] = m <= k ? 1 : window/m;
+    }
+}
+
+/*
+ * tables_longest_sequence for the "lanes" values of k from k0, at most
+ * LONGEST_LANES, in lockstep, writing their row of the table for every m
+ * as it goes. Each sequence only depends on its own past, so interleaving
+ * them overlaps the division of one with the others', where a single
+ * sequence waits for each of its divisions, and the row of m is stored in
+ * one contiguous run. Every value is computed exactly as in
+ * tables_longest_sequence, with p[m][l] holding p[m] of k0 + l.
+ */
+static void longestLanes(double* longest, double (*p)[LONGEST_LANES], double* suffix,
+                         int maxN, int k0, int lanes) {
+    double prefix[LONGEST_LANES];
+    int blockStart[LONGEST_LANES];
+    for (int l=0; l<lanes; l++) {
+        prefix[l] = 0;
+        blockStart[l] = 0;
+        p[0][l] = 1;
+    }
+
+    for (int m=1; m<=maxN; m++) {
+        for (int l=0; l<lanes; l++) { // the lanes complete their blocks at different m
+            int k = k0 + l;
+            if (m - 1 - blockStart[l] != k) continue;
+            double* s = suffix + (size_t)l*maxN;
+            double sum = 0;
+            for (int i=k-1; i>=0; i--) {
+                sum += p[blockStart[l] + i][l];
+                s[i] = sum;
+            }
+            blockStart[l] = m - 1;
+            prefix[l] = 0;
+        }
+        for (int l=0; l<lanes; l++) {
+            int k = k0 + l, offset = m - blockStart[l];
+            prefix[l] += p[m - 1][l];
+            double window = prefix[l];
+            if (blockStart[l] > 0 && offset < k) window += suffix[(size_t)l*maxN + offset];
+            p[m][l] = m <= k ? 1 : window/m;
+        }
+        double* row = longest + tables_row(m) + k0 - 1;
+        for (int l=0; l<lanes && k0 + l < m; l++) {
+            row[l] = p[m][l];
+        }
+    }
+}
+
+/*
+ * Fills the table LONGEST_LANES values of k at a time, so only the
+ * sequences of the current ones are kept in memory.
+ */
+static int buildLongest(double* longest, int maxN) {
+    double (*p)[LONGEST_LANES] = malloc(sizeof(*p)*(maxN + 1));
+    double* suffix = malloc(sizeof(double)*LONGEST_LANES*maxN);
+    if (p == NULL || suffix == NULL) {
+        free(p);
+        free(suffix);
+        return -1;
+    }
+
+    for (int k0=1; k0<maxN; k0+=LONGEST_LANES) {
+        longestLanes(longest, p, suffix, maxN, k0,
+                     maxN - k0 < LONGEST_LANES ? maxN - k0 : LONGEST_LANES);
+    }
+    for (int m=1; m<=maxN; m++) {
+        longest[tables_row(m) + m - 1] = 1;
+    }
+    free(p);
+    free(suffix);
+    return 0;
+}
+
+/*
+ * p(n, c) = P(exactly c cycles of n boxes). Box n either is a cycle of its
+ * own, with probability 1/n, or is inserted after one of the n-1 others:
+ * p(n, c) = (n-1)/n p(n-1, c) + 1/n p(n-1, c-1).
+ */
+static void buildCount(double* count, int maxN) {
+    count[0] = 1;
+    for (int n=2; n<=maxN; n++) {
+        const double* previous = count + tables_row(n - 1);
+        double* row = count + tables_row(n);
+        double stay = (n - 1.0)/n, alone = 1.0/n;
+
+        row[0] = stay*previous[0];
+        for (int c=2; c<n; c++) {
+            row[c - 1] = stay*previous[c - 1] + alone*previous[c - 2];
+        }
+        row[n - 1] = alone*previous[n - 2];
+    }
+}
+
+int tables_build(const char* path, int maxN) {
+    if (maxN < 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t entries = (size_t)maxN*(maxN + 1)/2;
+    size_t size = sizeof(struct tables_header) + 2*sizeof(double)*entries;
+
+    size_t pathLength = strlen(path);
+    char tmpPath[pathLength + 5];
+    memcpy(tmpPath, path, pathLength);
+    memcpy(tmpPath + pathLength, ".tmp", 5);
+
+    int fd = open(tmpPath, O_RDWR|O_CREAT|O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return -1;
+    }
+    char* base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -1;
+
+    struct tables_header* h = (struct tables_header*)base;
+    h->maxN = maxN;
+    h->reserved = 0;
+    h->longestOffset = sizeof(struct tables_header);
+    h->countOffset = h->longestOffset + sizeof(double)*entries;
+    h->size = size;
+    int ok = buildLongest((double*)(base + h->longestOffset), maxN);
+    buildCount((double*)(base + h->countOffset), maxN);
+    h->version = TABLES_VERSION;
+    h->magic = TABLES_MAGIC; // last, so an interrupted build is never valid
+
+    if (ok == 0) ok = msync(base, size, MS_SYNC);
+    munmap(base, size);
+    if (ok != 0 || rename(tmpPath, path) != 0) {
+        unlink(tmpPath);
+        return -1;
+    }
+    return 0;
+}
+
+int tables_open(tables* t, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(struct tables_header)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -1;
+
+    const struct tables_header* h = base;
+    size_t entries = (size_t)h->maxN*(h->maxN + 1)/2;
+    if (h->magic != TABLES_MAGIC || h->version != TABLES_VERSION || h->maxN < 1 ||
+        h->size != (uint64_t)st.st_size ||
+        h->countOffset + sizeof(double)*entries > h->size) {
+        munmap(base, st.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+    t->header = h;
+    t->longest = (const double*)((const char*)base + h->longestOffset);
+    t->count = (const double*)((const char*)base + h->countOffset);
+    t->size = st.st_size;
+    return 0;
+}
+
+void tables_close(tables* t) {
+    munmap((void*)t->header, t->size);
+    t->header = NULL;
+}
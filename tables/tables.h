@@ -0,0 +1,81 @@
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Exact distributions of the cycles of a random permutation of n boxes,
+ * for every n up to maxN, precomputed in a file that is then mapped read
+ * only, so a query costs a page cache lookup.
+ *
+ * longest: P(longest cycle <= k), which is the probability that every
+ *          prisoner finds his tag opening k boxes
+ * count:   P(exactly c cycles)
+ *
+ * Both are triangles of doubles: row n holds k (or c) = 1..n, starting at
+ * index n(n-1)/2. Probabilities below the smallest double are stored as 0.
+ */
+#define TABLES_MAGIC 0x43594354 // "CYCT"
+#define TABLES_VERSION 2 // 1 could hold small negative probabilities
+
+struct tables_header {
+    uint32_t magic;
+    uint32_t version;
+    int32_t maxN;
+    int32_t reserved;
+    uint64_t longestOffset; // bytes from the start of the file
+    uint64_t countOffset;
+    uint64_t size;          // bytes of the file
+};
+
+typedef struct {
+    const struct tables_header* header;
+    const double* longest;
+    const double* count;
+    size_t size; // bytes mapped
+} tables;
+
+/*
+ * Computes the tables for every n up to maxN and writes them to "path",
+ * through a temporary file renamed over it so readers never see a partial
+ * file. Returns 0, or -1 with errno set.
+ */
+int tables_build(const char* path, int maxN);
+
+/*
+ * Maps the tables at "path". Returns 0, or -1 with errno set, EINVAL if
+ * the file is not a tables file of this version.
+ */
+int tables_open(tables* t, const char* path);
+
+/*
+ * Computes p[m] = P(longest cycle of m boxes <= k) for m = 0..maxN.
+ * Conditioning on the length j of the first box's cycle,
+ * p[m] = 1/m * sum_{j=1..min(k,m)} p[m-j]. Sliding that sum by subtracting
+ * the value leaving it cancels to noise once p is tiny, so instead the
+ * values are split in blocks of k, and every sum is the suffix sum of the
+ * previous block plus the prefix sum of the current one. Only positive
+ * terms are added, so every p[m] keeps full relative precision.
+ *
+ * suffix is scratch room for k doubles.
+ */
+void tables_longest_sequence(double* p, double* suffix, int maxN, int k);
+
+void tables_close(tables* t);
+
+static inline long tables_row(int n) {
+    return (long)n*(n - 1)/2;
+}
+
+/*
+ * P(longest cycle <= k) for n boxes, n <= maxN.
+ */
+static inline double tables_longest_cdf(const tables* t, int n, int k) {
+    if (k >= n) return 1;
+    return k < 1 ? (n == 0) : t->longest[tables_row(n) + k - 1];
+}
+
+/*
+ * P(exactly c cycles) for n boxes, n <= maxN.
+ */
+static inline double tables_cycle_count(const tables* t, int n, int c) {
+    return c < 1 || c > n ? 0 : t->count[tables_row(n) + c - 1];
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "trace.h"
+
+uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Maps numBuffers empty buffers. Pages are only touched when events are
+ * written, so unused capacity costs no memory.
+ * Returns 0 on success and -1 on failure.
+ */
+int trace_open(tracer* t, int numBuffers) {
+    t->buffers = mmap(NULL, sizeof(struct trace_buffer)*numBuffers,
+                      PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_SHARED, -1, 0);
+    if (t->buffers == MAP_FAILED) {
+        t->buffers = NULL;
+        return -1;
+    }
+    t->numBuffers = numBuffers;
+    t->start = trace_now();
+    return 0;
+}
+
+void trace_name(tracer* t, int buffer, const char* name) {
+    snprintf(t->buffers[buffer].name, sizeof(t->buffers[buffer].name), "%s", name);
+}
+
+/*
+ * Writes every buffer as a Chrome trace JSON file, one track per buffer.
+ * Chunks and stalls are duration events and refills are instant events.
+ * Returns 0 on success and -1 on failure.
+ */
+int trace_dump(tracer* t, const char* path) {
+    FILE* f = fopen(path, "w");
+    if (f == NULL) return -1;
+
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    const char* separator = "";
+    for (int i = 0; i < t->numBuffers; i++) {
+        struct trace_buffer* b = &t->buffers[i];
+        if (b->count == 0) continue;
+
+        fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                   "\"args\": {\"name\": \"%s\"}}", separator, i, b->name);
+        separator = ",\n";
+        if (b->dropped > 0) {
+            fprintf(f, ",\n{\"name\": \"dropped %u events\", \"ph\": \"i\", \"s\": \"t\", "
+                       "\"pid\": 1, \"tid\": %d, \"ts\": 0}", b->dropped, i);
+        }
+
+        for (uint32_t j = 0; j < b->count; j++) {
+            struct trace_event* e = &b->events[j];
+            double ts = (e->time - t->start)/1000.0; // in us
+            switch (e->type) {
+            case TRACE_CHUNK_BEGIN:
+                fprintf(f, ",\n{\"name\": \"chunk\", \"ph\": \"B\", \"pid\": 1, \"tid\": %d, "
+                           "\"ts\": %.3f, \"args\": {\"first trial\": %llu}}",
+                        i, ts, (unsigned long long)e->arg);
+                break;
+            case TRACE_CHUNK_END:
+                fprintf(f, ",\n{\"name\": \"chunk\", \"ph\": \"E\", \"pid\": 1, \"tid\": %d, "
+                           "\"ts\": %.3f, \"args\": {\"trials\": %llu}}",
+                        i, ts, (unsigned long long)e->arg);
+                break;
+            case TRACE_REFILL:
+                fprintf(f, ",\n{\"name\": \"refill\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, "
+                           "\"tid\": %d, \"ts\": %.3f, \"args\": {\"block\": %llu}}",
+                        i, ts, (unsigned long long)e->arg);
+                break;
+            case TRACE_STALL_BEGIN:
+                fprintf(f, ",\n{\"name\": \"stall\", \"ph\": \"B\", \"pid\": 1, \"tid\": %d, "
+                           "\"ts\": %.3f}", i, ts);
+                break;
+            case TRACE_STALL_END:
+                fprintf(f, ",\n{\"name\": \"stall\", \"ph\": \"E\", \"pid\": 1, \"tid\": %d, "
+                           "\"ts\": %.3f}", i, ts);
+                break;
+            }
+        }
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+void trace_close(tracer* t) {
+    if (t->buffers != NULL) {
+        munmap(t->buffers, sizeof(struct trace_buffer)*t->numBuffers);
+    }
+    t->buffers = NULL;
+}
@@ -0,0 +1,60 @@
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Timeline of what every worker did, written in the Chrome trace format
+ * (chrome://tracing, https://ui.perfetto.dev).
+ *
+ * Every worker owns one buffer and is the only one writing to it, so
+ * recording an event takes no lock. The buffers are mapped shared before
+ * the workers are created, so both forked processes and threads can write
+ * to them, and the parent can dump them once the workers are done. Events
+ * recorded once a buffer is full are counted and dropped.
+ */
+#define TRACE_CAPACITY (1 << 18)
+
+enum trace_type {
+    TRACE_CHUNK_BEGIN,  // arg is the chunk's first trial
+    TRACE_CHUNK_END,    // arg is the number of trials simulated
+    TRACE_REFILL,       // the PRNG was seeded for a new block, arg is the block
+    TRACE_STALL_BEGIN,  // waiting for work or for other workers
+    TRACE_STALL_END,
+};
+
+struct trace_event {
+    uint64_t time; // monotonic time in ns
+    uint64_t arg;
+    uint32_t type;
+};
+
+struct trace_buffer {
+    uint32_t count;
+    uint32_t dropped;
+    char name[32];
+    struct trace_event events[TRACE_CAPACITY];
+};
+
+typedef struct {
+    struct trace_buffer* buffers;
+    int numBuffers;
+    uint64_t start; // time of trace_open, the origin of the timeline
+} tracer;
+
+int trace_open(tracer* t, int numBuffers);
+void trace_name(tracer* t, int buffer, const char* name);
+int trace_dump(tracer* t, const char* path);
+void trace_close(tracer* t);
+uint64_t trace_now(void);
+
+static inline void trace_record(tracer* t, int buffer, enum trace_type type, uint64_t arg) {
+    struct trace_buffer* b = &t->buffers[buffer];
+    if (b->count == TRACE_CAPACITY) {
+        b->dropped++;
+        return;
+    }
+    struct trace_event* e = &b->events[b->count];
+    e->time = trace_now();
+    e->arg = arg;
+    e->type = type;
+    b->count++;
+}
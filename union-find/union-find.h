@@ -1,6 +1,10 @@
+/*
+ * The p and size arrays are owned by the caller and must hold at least
+ * n elements before set_union_init is called.
+ */
 typedef struct {
-    int p[100];    // parent element
-    int size[100]; // num of elements in subtree i
+    int* p;          // parent element
+    int* size;       // num of elements in subtree i
     int n;           // num of elements in set
 } set_union;
 